@@ -44,7 +44,7 @@ module cache (
 
 // cache size configuration
 // the cache size in bytes is 8*(2^BITS), e.g. 2kBytes if BITS == 8
-localparam BITS = 8;	
+parameter BITS = 8;	
 								
 // _word_ address mapping example with 16 cache lines (BITS == 4)
 // 22 21 20 19 18 17 16 15 14 13 12 11 10  9  8  7  6  5  4  3  2  1  0
@@ -75,6 +75,12 @@
 #define M68K_INT_ACK_SPURIOUS      0xfffffffe
 
 
+/* Number of words (opcode and extension words) kept per decode cache entry.
+ * This covers the longest 68020 instruction.
+ */
+#define M68K_DECODE_CACHE_WORDS    11
+
+
 /* CPU types for use in m68k_set_cpu_type() */
 enum
 {
@@ -261,6 +267,17 @@ void m68k_set_fc_callback(void  (*callback)(unsigned int new_fc));
 void m68k_set_instr_hook_callback(void  (*callback)(void));
 
 
+/* Set the callback deciding which code may be kept in the decode cache.
+ * You must enable M68K_DECODE_CACHE in m68kconf.h.
+ * The CPU calls this callback with the address of an opcode that is not in
+ * the cache yet.  Return nonzero if the opcode and the following
+ * M68K_DECODE_CACHE_WORDS words may be cached.  The host must then call
+ * m68k_decode_cache_invalidate() whenever it writes to that memory.
+ * Default behavior: cache nothing.
+ */
+void m68k_set_decode_cache_callback(int  (*callback)(unsigned int address));
+
+
 
 /* ======================================================================== */
 /* ====================== FUNCTIONS TO ACCESS THE CPU ===================== */
@@ -297,6 +314,18 @@ int m68k_cycles_run(void);              /* Number of cycles run so far */
 int m68k_cycles_remaining(void);        /* Number of cycles left */
 void m68k_modify_timeslice(int cycles); /* Modify cycles left */
 void m68k_end_timeslice(void);          /* End timeslice now */
+unsigned int m68k_instructions_run(void); /* Number of instructions run so far */
+
+/* Drop all decoded instructions overlapping address to address+size-1
+ * from the decode cache.
+ */
+void m68k_decode_cache_invalidate(unsigned int address, unsigned int size);
+
+/* Number of times an opcode was executed since the last
+ * m68k_coverage_clear().  Always 0 unless M68K_COVERAGE is enabled.
+ */
+unsigned int m68k_coverage_count(unsigned int opcode);
+void m68k_coverage_clear(void);
 
 /* Set the IPL0-IPL2 pins on the CPU (IRQ).
  * A transition from < 7 to 7 will cause a non-maskable interrupt (NMI).
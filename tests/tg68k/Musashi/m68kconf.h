@@ -131,10 +131,44 @@
 /* If ON, CPU will call the instruction hook callback before every
  * instruction.
  */
+#ifndef M68K_INSTRUCTION_HOOK
 #define M68K_INSTRUCTION_HOOK       OPT_OFF
+#endif
 #define M68K_INSTRUCTION_CALLBACK() your_instruction_hook_function()
 
 
+/* If ON, the CPU keeps a direct mapped cache of decoded instructions
+ * (opcode handler and the following extension words) for code at addresses
+ * the decode cache callback agrees to. The host must call
+ * m68k_decode_cache_invalidate() whenever it writes to such memory.
+ * Cannot be combined with M68K_EMULATE_PREFETCH or M68K_COMPUTED_GOTO.
+ */
+#ifndef M68K_DECODE_CACHE
+#define M68K_DECODE_CACHE           OPT_OFF
+#endif /* M68K_DECODE_CACHE */
+#define M68K_DECODE_CACHE_CALLBACK(A) your_decode_cache_check_function(A)
+#define M68K_DECODE_CACHE_SIZE      4096
+
+
+/* If ON, m68k_execute() dispatches instructions through a computed goto
+ * table (a GCC extension) instead of the jump table.  This gives every
+ * handler its own indirect branch which helps the host branch predictor.
+ * Cannot be combined with M68K_DECODE_CACHE: the dispatch code repeated
+ * after every handler costs more than the shared loop with cached fetches.
+ */
+#ifndef M68K_COMPUTED_GOTO
+#define M68K_COMPUTED_GOTO          OPT_OFF
+#endif /* M68K_COMPUTED_GOTO */
+
+
+/* If ON, the CPU counts how often each opcode (jump table entry) was
+ * executed.  See m68k_coverage_count().
+ */
+#ifndef M68K_COVERAGE
+#define M68K_COVERAGE               OPT_OFF
+#endif /* M68K_COVERAGE */
+
+
 /* If ON, the CPU will emulate the 4-byte prefetch queue of a real 68000 */
 #define M68K_EMULATE_PREFETCH       OPT_OFF
 
@@ -76,6 +76,30 @@ uint    m68ki_aerr_address;
 uint    m68ki_aerr_write_mode;
 uint    m68ki_aerr_fc;
 
+/* Number of instructions executed in the current timeslice */
+uint    m68ki_instructions;
+
+#if M68K_COVERAGE
+/* Number of times each opcode was executed */
+uint    m68ki_coverage[0x10000];
+#endif /* M68K_COVERAGE */
+
+#if M68K_DECODE_CACHE
+typedef struct
+{
+	uint pc;                                /* Address of the opcode, odd if unused */
+	void (*handler)(void);                  /* Opcode handler */
+	uint16 words[M68K_DECODE_CACHE_WORDS];  /* Opcode and extension words */
+} m68ki_decode_entry;
+
+static m68ki_decode_entry m68ki_decode_cache[M68K_DECODE_CACHE_SIZE];
+
+/* Window of the instruction being executed if it came from the cache */
+uint    m68ki_dc_base;
+uint    m68ki_dc_len = 0;
+uint16* m68ki_dc_words;
+#endif /* M68K_DECODE_CACHE */
+
 /* Used by shift & rotate instructions */
 uint8 m68ki_shift_8_table[65] =
 {
@@ -409,6 +433,12 @@ static void default_instr_hook_callback(void)
 {
 }
 
+/* Called when an opcode is not in the decode cache */
+static int default_decode_cache_callback(unsigned int address)
+{
+	return 0;
+}
+
 
 #if M68K_EMULATE_ADDRESS_ERROR
 	#include <setjmp.h>
@@ -562,6 +592,11 @@ void m68k_set_instr_hook_callback(void  (*callback)(void))
 	CALLBACK_INSTR_HOOK = callback ? callback : default_instr_hook_callback;
 }
 
+void m68k_set_decode_cache_callback(int  (*callback)(unsigned int address))
+{
+	CALLBACK_DECODE_CACHE = callback ? callback : default_decode_cache_callback;
+}
+
 #include <stdio.h>
 /* Set the CPU type. */
 void m68k_set_cpu_type(unsigned int cpu_type)
@@ -635,10 +670,144 @@ void m68k_set_cpu_type(unsigned int cpu_type)
 	}
 }
 
+#if M68K_DECODE_CACHE
+/* Fetch the next opcode through the decode cache and return its handler */
+static void (*m68ki_decode_cache_fetch(void))(void)
+{
+	m68ki_decode_entry* entry = m68ki_decode_cache + ((REG_PC >> 1) & (M68K_DECODE_CACHE_SIZE-1));
+	uint i;
+
+	if(entry->pc != REG_PC)
+	{
+		m68ki_dc_len = 0;
+		if((REG_PC & 1) || !m68ki_decode_cache_check(ADDRESS_68K(REG_PC)))
+		{
+			REG_IR = m68ki_read_imm_16();
+			return m68ki_instruction_jump_table[REG_IR];
+		}
+
+		for(i=0;i<M68K_DECODE_CACHE_WORDS;i++)
+			entry->words[i] = m68k_read_immediate_16(ADDRESS_68K(REG_PC + 2*i));
+		entry->handler = m68ki_instruction_jump_table[entry->words[0]];
+		entry->pc = REG_PC;
+	}
+
+	m68ki_dc_base = REG_PC;
+	m68ki_dc_words = entry->words;
+	m68ki_dc_len = 2*M68K_DECODE_CACHE_WORDS;
+	REG_IR = entry->words[0];
+	REG_PC += 2;
+	return entry->handler;
+}
+
+void m68k_decode_cache_invalidate(unsigned int address, unsigned int size)
+{
+	/* an entry covers its opcode and the following extension words */
+	uint first = (address & ~1) - 2*(M68K_DECODE_CACHE_WORDS-1);
+	uint count = (address & 1) + size + 2*(M68K_DECODE_CACHE_WORDS-1);
+	uint pc;
+
+	if(size >= 2*M68K_DECODE_CACHE_SIZE)
+	{
+		for(pc=0;pc<M68K_DECODE_CACHE_SIZE;pc++)
+			m68ki_decode_cache[pc].pc = 1;
+		m68ki_dc_len = 0;
+		return;
+	}
+
+	for(pc = first;pc - first < count;pc += 2)
+	{
+		m68ki_decode_entry* entry = m68ki_decode_cache + ((pc >> 1) & (M68K_DECODE_CACHE_SIZE-1));
+		if(entry->pc == pc)
+			entry->pc = 1;
+	}
+
+	/* the running instruction reads its remaining words from memory */
+	if(address - m68ki_dc_base < m68ki_dc_len || m68ki_dc_base - address < size)
+		m68ki_dc_len = 0;
+}
+
+#define m68ki_fetch_instruction() m68ki_decode_cache_fetch()
+#else
+#define m68ki_fetch_instruction() m68ki_instruction_jump_table[REG_IR = m68ki_read_imm_16()]
+#endif /* M68K_DECODE_CACHE */
+
+
+#if M68K_COMPUTED_GOTO
+/* All opcode handlers in the order of the computed goto label table */
+static void (*const m68ki_goto_handlers[])(void) =
+{
+#define M68KI_OP(NAME) NAME,
+#include "m68kopgo.h"
+#undef M68KI_OP
+};
+
+/* Find the label table index of an opcode handler */
+static uint m68ki_goto_index(void (*handler)(void))
+{
+	static uint last = 0;
+	uint i;
+
+	/* neighbouring opcodes mostly share their handler */
+	if(m68ki_goto_handlers[last] == handler)
+		return last;
+
+	for(i=0;i<sizeof(m68ki_goto_handlers)/sizeof(m68ki_goto_handlers[0]);i++)
+		if(m68ki_goto_handlers[i] == handler)
+			return last = i;
+
+	return 0;
+}
+
+/* Start the next instruction.  Used at the end of every handler label */
+#define M68KI_GOTO_NEXT()                                          \
+	do                                                             \
+	{                                                              \
+		m68ki_trace_t1(); /* auto-disable (see m68kcpu.h) */       \
+		m68ki_use_data_space(); /* auto-disable (see m68kcpu.h) */ \
+		m68ki_instr_hook(); /* auto-disable (see m68kcpu.h) */     \
+		REG_PPC = REG_PC;                                          \
+		(void)m68ki_fetch_instruction();                           \
+		m68ki_instructions++;                                      \
+		m68ki_coverage_hit(); /* auto-disable (see m68kcpu.h) */   \
+		goto *m68ki_goto_table[REG_IR];                            \
+	} while(0)
+
+#define M68KI_GOTO_OP(NAME)                                        \
+	op_##NAME:                                                     \
+		NAME();                                                    \
+		USE_CYCLES(CYC_INSTRUCTION[REG_IR]);                       \
+		m68ki_exception_if_trace(); /* auto-disable (see m68kcpu.h) */ \
+		if(GET_CYCLES() <= 0)                                      \
+			goto done;                                             \
+		M68KI_GOTO_NEXT();
+#endif /* M68K_COMPUTED_GOTO */
+
+
 /* Execute some instructions until we use up num_cycles clock cycles */
 /* ASG: removed per-instruction interrupt checks */
 int m68k_execute(int num_cycles)
 {
+#if M68K_COMPUTED_GOTO
+	static void* m68ki_goto_table[0x10000];
+
+	if(!m68ki_goto_table[0])
+	{
+		static void* const labels[] =
+		{
+#define M68KI_OP(NAME) &&op_##NAME,
+#include "m68kopgo.h"
+#undef M68KI_OP
+		};
+		uint i;
+
+		for(i=0;i<0x10000;i++)
+			m68ki_goto_table[i] = labels[m68ki_goto_index(m68ki_instruction_jump_table[i])];
+	}
+#endif /* M68K_COMPUTED_GOTO */
+
+	m68ki_instructions = 0;
+
 	/* Make sure we're not stopped */
 	if(!CPU_STOPPED)
 	{
@@ -653,6 +822,14 @@ int m68k_execute(int num_cycles)
 		/* Return point if we had an address error */
 		m68ki_set_address_error_trap(); /* auto-disable (see m68kcpu.h) */
 
+#if M68K_COMPUTED_GOTO
+		/* Main loop.  Every handler label jumps straight to the next one */
+		M68KI_GOTO_NEXT();
+#define M68KI_OP(NAME) M68KI_GOTO_OP(NAME)
+#include "m68kopgo.h"
+#undef M68KI_OP
+done:
+#else
 		/* Main loop.  Keep going until we run out of clock cycles */
 		do
 		{
@@ -669,13 +846,15 @@ int m68k_execute(int num_cycles)
 			REG_PPC = REG_PC;
 
 			/* Read an instruction and call its handler */
-			REG_IR = m68ki_read_imm_16();
-			m68ki_instruction_jump_table[REG_IR]();
+			m68ki_instructions++;
+			m68ki_fetch_instruction()();
+			m68ki_coverage_hit(); /* auto-disable (see m68kcpu.h) */
 			USE_CYCLES(CYC_INSTRUCTION[REG_IR]);
 
 			/* Trace m68k_exception, if necessary */
 			m68ki_exception_if_trace(); /* auto-disable (see m68kcpu.h) */
 		} while(GET_CYCLES() > 0);
+#endif /* M68K_COMPUTED_GOTO */
 
 		/* set previous PC to current PC for the next entry into the loop */
 		REG_PPC = REG_PC;
@@ -696,6 +875,30 @@ int m68k_execute(int num_cycles)
 }
 
 
+unsigned int m68k_instructions_run(void)
+{
+	return m68ki_instructions;
+}
+
+unsigned int m68k_coverage_count(unsigned int opcode)
+{
+#if M68K_COVERAGE
+	return m68ki_coverage[opcode & 0xffff];
+#else
+	return 0;
+#endif /* M68K_COVERAGE */
+}
+
+void m68k_coverage_clear(void)
+{
+#if M68K_COVERAGE
+	uint i;
+
+	for(i = 0; i < 0x10000; i++)
+		m68ki_coverage[i] = 0;
+#endif /* M68K_COVERAGE */
+}
+
 int m68k_cycles_run(void)
 {
 	return m68ki_initial_cycles - GET_CYCLES();
@@ -755,6 +958,10 @@ void m68k_init(void)
 	m68k_set_pc_changed_callback(NULL);
 	m68k_set_fc_callback(NULL);
 	m68k_set_instr_hook_callback(NULL);
+	m68k_set_decode_cache_callback(NULL);
+#if M68K_DECODE_CACHE
+	m68k_decode_cache_invalidate(0, 0xffffffff);
+#endif /* M68K_DECODE_CACHE */
 }
 
 /* Pulse the RESET line on the CPU */
@@ -782,6 +989,10 @@ void m68k_pulse_reset(void)
 	CPU_PREF_ADDR = 0x1000;
 #endif /* M68K_EMULATE_PREFETCH */
 
+#if M68K_DECODE_CACHE
+	m68ki_dc_len = 0;
+#endif /* M68K_DECODE_CACHE */
+
 	/* Read the initial stack pointer and program counter */
 	m68ki_jump(0);
 	REG_SP = m68ki_read_imm_32();
@@ -814,6 +1025,9 @@ unsigned int m68k_get_context(void* dst)
 void m68k_set_context(void* src)
 {
 	if(src) m68ki_cpu = *(m68ki_cpu_core*)src;
+#if M68K_DECODE_CACHE
+	m68ki_dc_len = 0;
+#endif /* M68K_DECODE_CACHE */
 }
 
 
@@ -361,6 +361,7 @@
 #define CALLBACK_PC_CHANGED  m68ki_cpu.pc_changed_callback
 #define CALLBACK_SET_FC      m68ki_cpu.set_fc_callback
 #define CALLBACK_INSTR_HOOK  m68ki_cpu.instr_hook_callback
+#define CALLBACK_DECODE_CACHE m68ki_cpu.decode_cache_callback
 
 
 
@@ -471,6 +472,29 @@
 #endif /* M68K_MONITOR_PC */
 
 
+#if M68K_COVERAGE
+	#define m68ki_coverage_hit() m68ki_coverage[REG_IR]++
+#else
+	#define m68ki_coverage_hit()
+#endif /* M68K_COVERAGE */
+
+
+/* Ask the host if an opcode may be kept in the decode cache */
+#if M68K_DECODE_CACHE
+	#if M68K_EMULATE_PREFETCH
+		#error M68K_DECODE_CACHE cannot be combined with M68K_EMULATE_PREFETCH
+	#endif
+	#if M68K_COMPUTED_GOTO
+		#error M68K_DECODE_CACHE cannot be combined with M68K_COMPUTED_GOTO
+	#endif
+	#if M68K_DECODE_CACHE == OPT_SPECIFY_HANDLER
+		#define m68ki_decode_cache_check(A) M68K_DECODE_CACHE_CALLBACK(A)
+	#else
+		#define m68ki_decode_cache_check(A) CALLBACK_DECODE_CACHE(A)
+	#endif
+#endif /* M68K_DECODE_CACHE */
+
+
 /* Enable or disable function code emulation */
 #if M68K_EMULATE_FC
 	#if M68K_EMULATE_FC == OPT_SPECIFY_HANDLER
@@ -844,6 +868,7 @@ typedef struct
 	void (*pc_changed_callback)(unsigned int new_pc); /* Called when the PC changes by a large amount */
 	void (*set_fc_callback)(unsigned int new_fc);     /* Called when the CPU function code changes */
 	void (*instr_hook_callback)(void);                /* Called every instruction cycle prior to execution */
+	int  (*decode_cache_callback)(unsigned int address); /* Called to check if an opcode may be cached */
 
 } m68ki_cpu_core;
 
@@ -862,6 +887,19 @@ extern uint           m68ki_aerr_address;
 extern uint           m68ki_aerr_write_mode;
 extern uint           m68ki_aerr_fc;
 
+extern uint           m68ki_instructions;
+
+#if M68K_COVERAGE
+extern uint           m68ki_coverage[0x10000];
+#endif /* M68K_COVERAGE */
+
+#if M68K_DECODE_CACHE
+/* Words of the instruction being executed if it came from the decode cache */
+extern uint           m68ki_dc_base;
+extern uint           m68ki_dc_len;
+extern uint16*        m68ki_dc_words;
+#endif /* M68K_DECODE_CACHE */
+
 /* Read data immediately after the program counter */
 INLINE uint m68ki_read_imm_16(void);
 INLINE uint m68ki_read_imm_32(void);
@@ -1005,6 +1043,13 @@ INLINE uint m68ki_read_imm_16(void)
 	REG_PC += 2;
 	return MASK_OUT_ABOVE_16(CPU_PREF_DATA >> ((2-((REG_PC-2)&2))<<3));
 #else
+#if M68K_DECODE_CACHE
+	if(REG_PC - m68ki_dc_base < m68ki_dc_len)
+	{
+		REG_PC += 2;
+		return m68ki_dc_words[(REG_PC - 2 - m68ki_dc_base) >> 1];
+	}
+#endif /* M68K_DECODE_CACHE */
 	REG_PC += 2;
 	return m68k_read_immediate_16(ADDRESS_68K(REG_PC-2));
 #endif /* M68K_EMULATE_PREFETCH */
@@ -1035,6 +1080,14 @@ INLINE uint m68ki_read_imm_32(void)
 #else
 	m68ki_set_fc(FLAG_S | FUNCTION_CODE_USER_PROGRAM); /* auto-disable (see m68kcpu.h) */
 	m68ki_check_address_error(REG_PC, MODE_READ, FLAG_S | FUNCTION_CODE_USER_PROGRAM); /* auto-disable (see m68kcpu.h) */
+#if M68K_DECODE_CACHE
+	if(REG_PC - m68ki_dc_base < m68ki_dc_len && REG_PC - m68ki_dc_base + 4 <= m68ki_dc_len)
+	{
+		uint16* words = m68ki_dc_words + ((REG_PC - m68ki_dc_base) >> 1);
+		REG_PC += 4;
+		return ((uint)words[0] << 16) | words[1];
+	}
+#endif /* M68K_DECODE_CACHE */
 	REG_PC += 4;
 	return m68k_read_immediate_32(ADDRESS_68K(REG_PC-4));
 #endif /* M68K_EMULATE_PREFETCH */
@@ -395,6 +395,9 @@ static char* get_ea_mode_str(uint instruction, uint size)
 		case 0x30: case 0x31: case 0x32: case 0x33: case 0x34: case 0x35: case 0x36: case 0x37:
 		/* address register indirect with index */
 			extension = read_imm_16();
+			/* the 68000 and 68010 only know the brief format without scale */
+			if(g_cpu_type & (TYPE_68000 | TYPE_68010))
+				extension &= ~0x0700;
 
 			if(EXT_FULL(extension))
 			{
@@ -487,6 +490,9 @@ static char* get_ea_mode_str(uint instruction, uint size)
 		case 0x3b:
 		/* program counter with index */
 			extension = read_imm_16();
+			/* the 68000 and 68010 only know the brief format without scale */
+			if(g_cpu_type & (TYPE_68000 | TYPE_68010))
+				extension &= ~0x0700;
 
 			if(EXT_FULL(extension))
 			{
@@ -96,6 +96,7 @@ char* g_version = "3.3";
 #define FILENAME_OPS_AC     "m68kopac.c"
 #define FILENAME_OPS_DM     "m68kopdm.c"
 #define FILENAME_OPS_NZ     "m68kopnz.c"
+#define FILENAME_GOTO       "m68kopgo.h"
 
 
 /* Identifier sequences recognized by this program */
@@ -233,6 +234,7 @@ void write_body(FILE* filep, body_struct* body, replace_struct* replace);
 void get_base_name(char* base_name, opcode_struct* op);
 void write_prototype(FILE* filep, char* base_name);
 void write_function_name(FILE* filep, char* base_name);
+void write_goto_entry(FILE* filep, char* base_name);
 void add_opcode_output_table_entry(opcode_struct* op, char* name);
 static int DECL_SPEC compare_nof_true_bits(const void* aptr, const void* bptr);
 void print_opcode_output_table(FILE* filep);
@@ -261,6 +263,7 @@ FILE* g_table_file = NULL;
 FILE* g_ops_ac_file = NULL;
 FILE* g_ops_dm_file = NULL;
 FILE* g_ops_nz_file = NULL;
+FILE* g_goto_file = NULL;
 
 int g_num_functions = 0;  /* Number of functions processed */
 int g_num_primitives = 0; /* Number of function primitives read */
@@ -466,6 +469,7 @@ void error_exit(char* fmt, ...)
 	if(g_ops_ac_file) fclose(g_ops_ac_file);
 	if(g_ops_dm_file) fclose(g_ops_dm_file);
 	if(g_ops_nz_file) fclose(g_ops_nz_file);
+	if(g_goto_file) fclose(g_goto_file);
 	if(g_input_file) fclose(g_input_file);
 
 	exit(EXIT_FAILURE);
@@ -485,6 +489,7 @@ void perror_exit(char* fmt, ...)
 	if(g_ops_ac_file) fclose(g_ops_ac_file);
 	if(g_ops_dm_file) fclose(g_ops_dm_file);
 	if(g_ops_nz_file) fclose(g_ops_nz_file);
+	if(g_goto_file) fclose(g_goto_file);
 	if(g_input_file) fclose(g_input_file);
 
 	exit(EXIT_FAILURE);
@@ -781,6 +786,12 @@ void write_function_name(FILE* filep, char* base_name)
 	fprintf(filep, "void %s(void)\n", base_name);
 }
 
+/* Write an entry in the computed goto handler list */
+void write_goto_entry(FILE* filep, char* base_name)
+{
+	fprintf(filep, "M68KI_OP(%s)\n", base_name);
+}
+
 void add_opcode_output_table_entry(opcode_struct* op, char* name)
 {
 	opcode_struct* ptr;
@@ -862,6 +873,7 @@ void generate_opcode_handler(FILE* filep, body_struct* body, replace_struct* rep
 	set_opcode_struct(opinfo, op, ea_mode);
 	get_base_name(str, op);
 	write_prototype(g_prototype_file, str);
+	write_goto_entry(g_goto_file, str);
 	add_opcode_output_table_entry(op, str);
 	write_function_name(filep, str);
 
@@ -1278,6 +1290,13 @@ int main(int argc, char **argv)
 	if((g_ops_nz_file = fopen(filename, "wt")) == NULL)
 		perror_exit("Unable to create ops nz file (%s)\n", filename);
 
+	sprintf(filename, "%s%s", output_path, FILENAME_GOTO);
+	if((g_goto_file = fopen(filename, "wt")) == NULL)
+		perror_exit("Unable to create goto file (%s)\n", filename);
+	fprintf(g_goto_file, "/* List of all opcode handlers for the computed goto dispatcher.\n");
+	fprintf(g_goto_file, " * Define M68KI_OP(NAME) before including this file.\n");
+	fprintf(g_goto_file, " */\n\n");
+
 	if((g_input_file=fopen(g_input_filename, "rt")) == NULL)
 		perror_exit("can't open %s for input", g_input_filename);
 
@@ -1415,6 +1434,7 @@ int main(int argc, char **argv)
 	fclose(g_ops_ac_file);
 	fclose(g_ops_dm_file);
 	fclose(g_ops_nz_file);
+	fclose(g_goto_file);
 	fclose(g_input_file);
 
 	printf("Generated %d opcode handlers from %d primitives\n", g_num_functions, g_num_primitives);
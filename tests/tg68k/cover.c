@@ -0,0 +1,30 @@
+#include <stdio.h>
+
+#include "cover.h"
+
+// merge a coverage file into map. Returns -1 if it can't be read
+int cover_load(const char *name, unsigned char *map) {
+  unsigned char buf[COVER_BYTES];
+  int i;
+
+  FILE *f = fopen(name, "rb");
+  if(!f) return -1;
+
+  int r = fread(buf, 1, COVER_BYTES, f);
+  fclose(f);
+  if(r != COVER_BYTES) return -1;
+
+  for(i=0;i<COVER_BYTES;i++)
+    map[i] |= buf[i];
+
+  return 0;
+}
+
+int cover_save(const char *name, const unsigned char *map) {
+  FILE *f = fopen(name, "wb");
+  if(!f) { perror(name); return -1; }
+
+  fwrite(map, 1, COVER_BYTES, f);
+  fclose(f);
+  return 0;
+}
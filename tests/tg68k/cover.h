@@ -0,0 +1,14 @@
+#ifndef COVER_H
+#define COVER_H
+
+// opcode coverage bitmap, one bit per opcode word. Files are raw
+// bitmaps, so merging them is a simple or
+#define COVER_BYTES  (0x10000/8)
+
+#define COVER_HIT(m,op)  ((m)[(op)>>3] & (1<<((op)&7)))
+#define COVER_SET(m,op)  ((m)[(op)>>3] |= (1<<((op)&7)))
+
+int cover_load(const char *name, unsigned char *map);
+int cover_save(const char *name, const unsigned char *map);
+
+#endif // COVER_H
@@ -0,0 +1,362 @@
+// native random instruction stream generator for tg68k/musashi tests.
+// Opcodes are picked from the ones the Musashi disassembler considers
+// valid and extension words are filled with random values. The
+// disassembler then tells how many of them the instruction uses.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mem.h"
+#include "gen.h"
+#include "Musashi/m68k.h"
+
+static int cpu = M68K_CPU_TYPE_68020;
+
+// all opcodes the generator may use
+static unsigned short *allowed = NULL;
+static int allowed_count = 0;
+
+static unsigned int rng;
+
+// xorshift32, fast and the same on every host
+static unsigned int gen_rand(void) {
+  rng ^= rng << 13;
+  rng ^= rng >> 17;
+  rng ^= rng << 5;
+  return rng;
+}
+
+static void gen_seed(unsigned int seed) {
+  rng = seed * 2654435761u ^ 0x9e3779b9;
+  if(!rng) rng = 1;
+}
+
+// same distribution as my_random() in randomize.c: 1/3 negative
+// numbers, 1/3 positive and 1/3 0, -1, min and max
+static unsigned int gen_value(unsigned int mask) {
+  unsigned int r = gen_rand();
+  unsigned int sign = (mask >> 1) + 1;
+
+  switch(r % 3) {
+  case 0:  return (gen_rand() & mask) | sign;
+  case 1:  return (gen_rand() & mask) & ~sign;
+  }
+
+  switch((r >> 8) & 3) {
+  case 0:  return mask;
+  case 1:  return 0;
+  case 2:  return sign;
+  }
+  return mask ^ sign;
+}
+
+// instructions that leave the generated code or stop the cpu and the
+// privileged ones that change the supervisor state. Mnemonics starting
+// with a digit are coprocessor instructions, "dc.w" is used for illegal
+// opcodes
+static int excluded(const char *m, const char *str) {
+  static const char *list[] = {
+    "jmp", "jsr", "rts", "rtr", "rte", "rtd", "rtm", "callm", "stop",
+    "reset", "movec", "moves", "bkpt", "cinv", "cpush", "move16", "dc",
+    NULL };
+  int i;
+
+  if((m[0] >= '0') && (m[0] <= '9')) return 1;
+
+  // bra, bsr and all bcc
+  if((m[0] == 'b') && (strlen(m) == 3)) return 1;
+
+  // dbra and all dbcc
+  if(!strncmp(m, "db", 2)) return 1;
+
+  for(i=0;list[i];i++)
+    if(!strncmp(m, list[i], strlen(list[i])))
+      return 1;
+
+  // move, andi, ori and eori to sr, move to and from usp
+  if(strstr(str, ", SR") || strstr(str, "USP"))
+    return 1;
+
+  return 0;
+}
+
+// check if mnemonic m is in the comma separated list of prefixes
+static int selected(const char *m, const char *list) {
+  while(list && *list) {
+    const char *end = strchr(list, ',');
+    int len = end?(end-list):strlen(list);
+    if(len && !strncmp(m, list, len))
+      return 1;
+    list = end?end+1:NULL;
+  }
+  return 0;
+}
+
+// disassemble the instruction at pc, returns its size in bytes and
+// leaves the bare mnemonic in m
+static int gen_disasm(unsigned int pc, char *str, char *m) {
+  int size = m68k_disassemble(str, pc, cpu);
+  int i;
+
+  for(i=0;str[i] && str[i] != ' ' && str[i] != '.' && i<15;i++)
+    m[i] = str[i];
+  m[i] = 0;
+  return size;
+}
+
+void gen_init(int cpu_type, const char *mnemonics) {
+  char str[100], m[16];
+  unsigned int op;
+
+  cpu = cpu_type;
+  if(!allowed) allowed = malloc(0x10000 * sizeof(unsigned short));
+  allowed_count = 0;
+
+  // classify all opcodes once with zero extension words
+  memset(code + GEN_START, 0, 2*GEN_MAX_WORDS);
+  for(op=0;op<0x10000;op++) {
+    if(!m68k_is_valid_instruction(op, cpu))
+      continue;
+
+    MEM_PUT16(code + GEN_START, op);
+    gen_disasm(GEN_START, str, m);
+    if(excluded(m, str) || (mnemonics && !selected(m, mnemonics)))
+      continue;
+
+    allowed[allowed_count++] = op;
+  }
+
+  if(!allowed_count) {
+    fprintf(stderr, "No opcodes left to generate\n");
+    exit(-1);
+  }
+}
+
+// let the disassembler decide how many of the extension words the
+// instruction actually uses
+void gen_instr_len(gen_instr_t *in) {
+  char str[100], m[16];
+  int j;
+
+  for(j=0;j<GEN_MAX_WORDS;j++)
+    MEM_PUT16(code + GEN_START + 2*j, in->words[j]);
+
+  in->len = gen_disasm(GEN_START, str, m) / 2;
+  if(in->len < 1) in->len = 1;
+  if(in->len > GEN_MAX_WORDS) in->len = GEN_MAX_WORDS;
+}
+
+// the 68000 only knows the brief index extension word without scale.
+// The disassembler ignores bits 8-10 of it for the 68000, so a word
+// whose bits 8-10 don't change the disassembly is an index extension
+// word. They are cleared, so tg68k in 68020 mode runs the same code
+static void gen_brief_ext(gen_instr_t *in) {
+  char str[100], str2[100], m[16];
+  int j;
+
+  if(cpu != M68K_CPU_TYPE_68000) return;
+
+  for(j=1;j<in->len;j++) {
+    if(!(in->words[j] & 0x0700)) continue;
+
+    MEM_PUT16(code + GEN_START + 2*j, in->words[j]);
+    gen_disasm(GEN_START, str, m);
+    MEM_PUT16(code + GEN_START + 2*j, in->words[j] & ~0x0700);
+    gen_disasm(GEN_START, str2, m);
+    if(!strcmp(str, str2))
+      in->words[j] &= ~0x0700;
+    else
+      MEM_PUT16(code + GEN_START + 2*j, in->words[j]);
+  }
+}
+
+void gen_random_case(gen_case_t *c, unsigned int seed, int count) {
+  int i, j;
+
+  if(count > GEN_MAX_INSTR) count = GEN_MAX_INSTR;
+
+  gen_seed(seed);
+  c->seed = seed;
+  c->count = count;
+
+  for(i=0;i<8;i++)
+    c->regs[i] = gen_value(0xffffffff);
+
+  // address registers point somewhere into the ram
+  for(i=8;i<15;i++)
+    c->regs[i] = GEN_DATA + (gen_rand() & 0x3fff) - 0x2000;
+
+  c->ccr = gen_rand() & 0x1f;
+  c->data_seed = gen_rand() | 1;
+
+  for(i=0;i<count;i++) {
+    gen_instr_t *in = &c->instr[i];
+
+    in->words[0] = allowed[gen_rand() % allowed_count];
+    for(j=1;j<GEN_MAX_WORDS;j++)
+      in->words[j] = gen_value(0xffff);
+
+    gen_instr_len(in);
+    gen_brief_ext(in);
+  }
+}
+
+static unsigned char *put16(unsigned char *p, unsigned int v) {
+  MEM_PUT16(p, v);
+  return p+2;
+}
+
+static unsigned char *put32(unsigned char *p, unsigned int v) {
+  MEM_PUT32(p, v);
+  return p+4;
+}
+
+// store ccr and all registers in the result area and exit. The 68000
+// has no move from ccr and no format word in its exception frame
+static unsigned char *put_dump(unsigned char *p, int exit_code) {
+  if(cpu == M68K_CPU_TYPE_68000)
+    p = put16(p, 0x40f9);          // move sr,RESULT_ADDR+64
+  else
+    p = put16(p, 0x42f9);          // move ccr,RESULT_ADDR+64
+  p = put32(p, RESULT_ADDR+64);
+  p = put16(p, 0x48f9);            // movem.l d0-d7/a0-a7,RESULT_ADDR
+  p = put16(p, 0xffff);
+  p = put32(p, RESULT_ADDR);
+  if(exit_code && (cpu != M68K_CPU_TYPE_68000)) {
+    p = put16(p, 0x33ef);          // move.w 6(a7),RESULT_ADDR+66
+    p = put16(p, 6);               // (format and vector offset)
+    p = put32(p, RESULT_ADDR+66);
+  }
+  p = put16(p, 0x13fc);            // move.b #exit_code,EXIT_ADDR
+  p = put16(p, exit_code);
+  p = put32(p, EXIT_ADDR);
+  p = put16(p, 0x60fe);            // bra *
+  return p;
+}
+
+// write the test program into rom. Returns the address behind the code
+unsigned int gen_emit_code(gen_case_t *c) {
+  unsigned char *p = code;
+  int i, j;
+
+  // reset and exception vectors
+  p = put32(p, GEN_STACK);
+  p = put32(p, GEN_START);
+  for(i=2;i<256;i++)
+    p = put32(p, GEN_HANDLER);
+
+  put_dump(code + GEN_HANDLER, 1);
+
+  p = code + GEN_START;
+  for(i=0;i<8;i++) {
+    p = put16(p, 0x203c | (i<<9)); // move.l #x,dn
+    p = put32(p, c->regs[i]);
+  }
+  for(i=0;i<7;i++) {
+    p = put16(p, 0x207c | (i<<9)); // movea.l #x,an
+    p = put32(p, c->regs[8+i]);
+  }
+  p = put16(p, 0x44fc);            // move #x,ccr
+  p = put16(p, c->ccr);
+
+  for(i=0;i<c->count;i++) {
+    if(p - code + 2*c->instr[i].len + 32 > GEN_END) {
+      c->count = i;
+      break;
+    }
+
+    c->instr[i].pc = p - code;
+    for(j=0;j<c->instr[i].len;j++)
+      p = put16(p, c->instr[i].words[j]);
+  }
+
+  p = put_dump(p, 0);
+  return p - code;
+}
+
+// fill the ram with the test data of the case
+void gen_emit_data(const gen_case_t *c) {
+  int i;
+
+  if(!c->data_seed) {
+    memset(ram, 0, RAMSIZE);
+    return;
+  }
+
+  gen_seed(c->data_seed);
+  for(i=0;i<RAMSIZE;i+=4)
+    MEM_PUT32(ram+i, gen_value(0xffffffff));
+}
+
+unsigned int gen_emit(gen_case_t *c) {
+  gen_emit_data(c);
+  return gen_emit_code(c);
+}
+
+void gen_list(FILE *out, const gen_case_t *c) {
+  char str[100], m[16];
+  int i, j;
+
+  fprintf(out, "; seed %u, %d instructions\n", c->seed, c->count);
+  for(i=0;i<8;i++)
+    fprintf(out, ";   d%d = %08x\n", i, c->regs[i]);
+  for(i=0;i<7;i++)
+    fprintf(out, ";   a%d = %08x\n", i, c->regs[8+i]);
+  fprintf(out, ";   ccr = %02x\n", c->ccr);
+
+  for(i=0;i<c->count;i++) {
+    gen_disasm(c->instr[i].pc, str, m);
+    fprintf(out, "%08x: ", c->instr[i].pc);
+    for(j=0;j<GEN_MAX_WORDS;j++) {
+      if(j < c->instr[i].len) fprintf(out, "%04x ", c->instr[i].words[j]);
+      else if(j < 5)          fprintf(out, "     ");
+    }
+    fprintf(out, " %s\n", str);
+  }
+}
+
+static int exit_code;
+
+static void gen_exit(int code) {
+  exit_code = code;
+  m68k_end_timeslice();
+}
+
+// run the emitted case on Musashi. The caller has to set up Musashi
+// and its memory callbacks. Returns the exit code or -1 if the program
+// didn't finish within max_cycles. A reset doesn't touch e.g. usp and
+// msp, so every case starts from the context of the first one
+int gen_run(int max_cycles) {
+  static void *context = NULL;
+  int cycles = 0;
+
+  if(!context) {
+    context = malloc(m68k_context_size());
+    m68k_get_context(context);
+  } else
+    m68k_set_context(context);
+
+#if M68K_DECODE_CACHE
+  m68k_decode_cache_invalidate(0, ROMSIZE);
+#endif
+  mem_exit = gen_exit;
+  m68k_pulse_reset();
+
+  exit_code = -1;
+  while((exit_code < 0) && (cycles < max_cycles))
+    cycles += m68k_execute(1000);
+
+  return exit_code;
+}
+
+// write rom and ram as one image that mem_init() can load
+int gen_write(const char *name) {
+  FILE *f = fopen(name, "wb");
+  if(!f) { perror(name); return -1; }
+
+  fwrite(code, 1, ROMSIZE, f);
+  fwrite(ram, 1, RAMSIZE, f);
+  fclose(f);
+  return 0;
+}
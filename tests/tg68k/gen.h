@@ -0,0 +1,42 @@
+#ifndef GEN_H
+#define GEN_H
+
+#include <stdio.h>
+
+// layout of generated test programs
+#define GEN_HANDLER  0x400     // exception handler, all vectors point here
+#define GEN_START    0x440     // register setup followed by the test code
+#define GEN_END      0x8000    // code must end below this address
+#define GEN_DATA     0x18000   // address registers point around here
+#define GEN_STACK    0x1fff0   // initial supervisor stack
+
+#define GEN_MAX_INSTR  256
+#define GEN_MAX_WORDS  11      // longest 68020 instruction
+
+typedef struct {
+  unsigned short words[GEN_MAX_WORDS];
+  int len;                     // number of words
+  unsigned int pc;             // address after gen_emit()
+} gen_instr_t;
+
+// a test case. It can be edited (e.g. by a minimizer) and emitted again
+typedef struct {
+  unsigned int seed;
+  unsigned int regs[15];       // initial d0-d7 and a0-a6
+  unsigned int ccr;
+  unsigned int data_seed;      // random ram contents, 0 = all zero
+  int count;
+  gen_instr_t instr[GEN_MAX_INSTR];
+} gen_case_t;
+
+void gen_init(int cpu_type, const char *mnemonics);
+void gen_instr_len(gen_instr_t *in);
+void gen_random_case(gen_case_t *c, unsigned int seed, int count);
+unsigned int gen_emit(gen_case_t *c);
+unsigned int gen_emit_code(gen_case_t *c);
+void gen_emit_data(const gen_case_t *c);
+void gen_list(FILE *out, const gen_case_t *c);
+int gen_run(int max_cycles);
+int gen_write(const char *name);
+
+#endif // GEN_H
@@ -0,0 +1,140 @@
+// annotate bus traces with the disassembly of the fetched instructions.
+// Understands the memory log of tg68k_run and m68k_run ("mem_read(...)")
+// and the code fetch trace written via TG68K_CYCLES ("clock address").
+// The disassembly is kept per address and opcode words, so loops don't
+// hit the disassembler again
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "mem.h"
+#include "m68k_mem.h"
+#include "sym.h"
+#include "Musashi/m68k.h"
+
+#define CACHE_SIZE  65536          // entries, direct mapped by address
+#define MAX_WORDS   11
+
+typedef struct {
+  unsigned int pc;                 // odd = unused
+  unsigned short words[MAX_WORDS];
+  int len;                         // in words
+  char text[112];
+} entry_t;
+
+static entry_t *cache;
+static int symbols = 0;
+static unsigned long hits = 0, misses = 0;
+
+static entry_t *lookup(unsigned int pc) {
+  entry_t *e = &cache[(pc >> 1) & (CACHE_SIZE-1)];
+  int i;
+
+  // still valid if the opcode words are the same
+  if(e->pc == pc) {
+    for(i=0;i<e->len && e->words[i] == mem_peek(pc+2*i);i++);
+    if(i == e->len) {
+      hits++;
+      return e;
+    }
+  }
+
+  misses++;
+  char str[100];
+  int size = m68k_disassemble(str, pc, M68K_CPU_TYPE_68020);
+
+  e->pc = pc;
+  e->len = size/2;
+  if(e->len < 1) e->len = 1;
+  if(e->len > MAX_WORDS) e->len = MAX_WORDS;
+  for(i=0;i<e->len;i++)
+    e->words[i] = mem_peek(pc+2*i);
+
+  if(symbols)
+    snprintf(e->text, sizeof(e->text), "  ; %s: %s\n", sym_format(pc), str);
+  else
+    snprintf(e->text, sizeof(e->text), "  ; %s\n", str);
+  return e;
+}
+
+// get the address of a possible fetch from a trace line. The memory log
+// doesn't tell code from data, so only reads of the code image count.
+// The TG68K_CYCLES trace only has fetches. WRITES lines have more fields
+static int fetch_addr(const char *line, unsigned int *addr) {
+  char *end;
+
+  if(!strncmp(line, "mem_read(0x", 11)) {
+    *addr = strtoul(line+11, NULL, 16);
+    return !(*addr & 1) && (mem_page[MEM_PAGE(*addr)].flags & MEM_ROM);
+  }
+
+  if(line[0] >= '0' && line[0] <= '9') {
+    strtoul(line, &end, 10);
+    if(*end != ' ') return 0;
+    *addr = strtoul(end+1, &end, 16);
+    return !*end && !(*addr & 1) && mem_page[MEM_PAGE(*addr)].ptr;
+  }
+
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  static char line[4096];
+  unsigned int addr, ext = 0, ext_end = 0;
+  int i;
+
+  for(i=1;i<argc;i++) {
+    if(!strcmp(argv[i], "-s") && i<argc-1) symbols = (sym_load(argv[++i]) > 0);
+    else break;
+  }
+
+  if((i != argc-1) && (i != argc-2)) {
+    printf("Usage: m68k_annotate [-s symbols] code.bin [trace]\n");
+    printf("  reads the trace from stdin if no file is given\n");
+    return -1;
+  }
+
+  FILE *in = stdin;
+  if(i == argc-2) {
+    in = fopen(argv[i+1], "r");
+    if(!in) { perror(argv[i+1]); return -1; }
+  }
+
+  // the messages of mem_init() would end up in the annotated trace
+  FILE *out = fdopen(dup(1), "w");
+  freopen("/dev/null", "w", stdout);
+  mem_verbose = 0;
+  mem_init(argv[i]);
+
+  cache = malloc(CACHE_SIZE * sizeof(entry_t));
+  for(i=0;i<CACHE_SIZE;i++)
+    cache[i].pc = 1;
+
+  setvbuf(out, NULL, _IOFBF, 1<<16);
+
+  while(fgets(line, sizeof(line), in)) {
+    int len = strlen(line);
+    if(len && line[len-1] == '\n') line[--len] = 0;
+    fputs(line, out);
+
+    // fetches right behind an instruction are its extension words
+    if(fetch_addr(line, &addr)) {
+      if(addr == ext && addr < ext_end) {
+	ext += 2;
+      } else {
+	entry_t *e = lookup(addr);
+	fputs(e->text, out);
+	ext = addr + 2;
+	ext_end = addr + 2*e->len;
+	continue;
+      }
+    }
+    fputc('\n', out);
+  }
+
+  fflush(out);
+  fprintf(stderr, "%lu instructions disassembled, %lu from cache\n", misses, hits);
+  return 0;
+}
@@ -0,0 +1,199 @@
+// merge opcode coverage bitmaps and report which valid opcodes were never
+// executed. Opcodes are grouped by mnemonic and addressing modes as shown
+// by the Musashi disassembler
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mem.h"
+#include "cover.h"
+#include "Musashi/m68k.h"
+
+// scratch area for disassembling single opcodes
+#define SCRATCH       0x1000
+#define SCRATCH_WORDS 11
+
+#define MAX_CLASSES 8192
+
+// disassembly and class names, a name can be as long as its disassembly
+#define STR_LEN     100
+
+typedef struct {
+  char name[STR_LEN];
+  unsigned int valid, hit;
+  unsigned short first;       // first unexecuted opcode
+} class_t;
+
+static class_t classes[MAX_CLASSES];
+static int nclasses = 0;
+
+static void usage(void) {
+  printf("Usage: m68k_cover [options] file...\n");
+  printf("  -000       report valid 68000 opcodes (default is 68020)\n");
+  printf("  -o file    write the merged bitmap\n");
+  printf("  -l         list every unexecuted opcode\n");
+  printf("  -a         also show fully covered classes\n");
+  exit(-1);
+}
+
+// addressing mode of one disassembled operand
+static const char *mode(char *op) {
+  static char buf[16];
+  int len;
+
+  while(*op == ' ') op++;
+  len = strlen(op);
+  while(len && op[len-1] == ' ') op[--len] = 0;
+
+  if(!len)                                    return "";
+  if(op[0] == '#')                            return "#imm";
+  if(op[0] == '-' && op[1] == '(')            return "-(An)";
+  if(op[0] == '[' || !strncmp(op, "([", 2))   return "([..])";
+  if(op[0] == '(') {
+    int commas = 0, pc = (strstr(op, "PC") != NULL);
+    char *p;
+    for(p=op;*p;p++) if(*p == ',') commas++;
+
+    if(op[len-1] == '+')   return "(An)+";
+    if(!commas)            return "(An)";
+    if(strchr(op, '['))    return pc?"([..],PC)":"([..],An)";
+    if(commas == 1 && !strncmp(op, "(PC,", 4)) return "(d8,PC,Xn)";
+    if(commas == 1 && op[1] == 'A')           return "(d8,An,Xn)";
+    if(commas == 1)        return pc?"(d16,PC)":"(d16,An)";
+    return pc?"(d,PC,Xn)":"(d,An,Xn)";
+  }
+  if(op[0] == 'D' && op[1] >= '0' && op[1] <= '7' && !op[2])  return "Dn";
+  if(op[0] == 'A' && op[1] >= '0' && op[1] <= '7' && !op[2])  return "An";
+  if(op[0] == '$' && !strcmp(op+len-2, ".w"))  return "abs.w";
+  if(op[0] == '$' && !strcmp(op+len-2, ".l"))  return "abs.l";
+  if(strchr(op, '-') || strchr(op, '/'))       return "list";
+  if(strspn(op, "0123456789abcdef") == len)   return "label";
+
+  // special registers like CCR, SR or USP stay as they are
+  snprintf(buf, sizeof(buf), "%s", op);
+  return buf;
+}
+
+// build the class name from a disassembly like "move.l  (A0)+, D0"
+static void classify(char *str, char *name, int size) {
+  char *p, *ops;
+  int depth = 0, n = 0;
+
+  // drop comments and bitfield specs
+  if((p = strchr(str, ';'))) *p = 0;
+  if((p = strchr(str, '{'))) { *p = 0; }
+
+  ops = strchr(str, ' ');
+  if(ops) *ops++ = 0;
+  snprintf(name, size, "%s", str);
+  if(!ops) return;
+
+  // split the operands on commas outside of parentheses
+  for(p=ops;;p++) {
+    if(*p == '(' || *p == '[') depth++;
+    if(*p == ')' || *p == ']') depth--;
+
+    if((!*p) || (*p == ',' && !depth)) {
+      char c = *p;
+      *p = 0;
+      const char *m = mode(ops);
+      if(*m) {
+	strncat(name, n++?",":" ", size - strlen(name) - 1);
+	strncat(name, m, size - strlen(name) - 1);
+      }
+      if(!c) break;
+      ops = p+1;
+    }
+  }
+}
+
+static class_t *get_class(const char *name) {
+  int i;
+
+  for(i=0;i<nclasses;i++)
+    if(!strcmp(classes[i].name, name))
+      return &classes[i];
+
+  if(nclasses == MAX_CLASSES) return NULL;
+  memset(&classes[nclasses], 0, sizeof(class_t));
+  strcpy(classes[nclasses].name, name);
+  return &classes[nclasses++];
+}
+
+static void disassemble(unsigned int op, int cpu, char *str) {
+  memset(code + SCRATCH, 0, 2*SCRATCH_WORDS);
+  MEM_PUT16(code + SCRATCH, op);
+  m68k_disassemble(str, SCRATCH, cpu);
+}
+
+int main(int argc, char **argv) {
+  unsigned char map[COVER_BYTES] = { 0 };
+  int cpu = M68K_CPU_TYPE_68020, list = 0, all = 0;
+  unsigned int valid = 0, hit = 0, op;
+  char *out = NULL, str[STR_LEN], name[STR_LEN];
+  int i, files = 0;
+
+  for(i=1;i<argc;i++) {
+    if(!strcmp(argv[i], "-000"))                  cpu = M68K_CPU_TYPE_68000;
+    else if(!strcmp(argv[i], "-o") && i<argc-1)   out = argv[++i];
+    else if(!strcmp(argv[i], "-l"))               list = 1;
+    else if(!strcmp(argv[i], "-a"))               all = 1;
+    else if(argv[i][0] == '-')                    usage();
+    else {
+      if(cover_load(argv[i], map))
+	fprintf(stderr, "unable to read %s\n", argv[i]);
+      files++;
+    }
+  }
+  if(!files) usage();
+
+  if(out && cover_save(out, map))
+    return -1;
+
+  mem_verbose = 0;
+  mem_init(NULL);
+
+  for(op=0;op<0x10000;op++) {
+    if(!m68k_is_valid_instruction(op, cpu))
+      continue;
+
+    disassemble(op, cpu, str);
+    classify(str, name, sizeof(name));
+    class_t *c = get_class(name);
+    if(!c) continue;
+
+    c->valid++;
+    valid++;
+    if(COVER_HIT(map, op)) {
+      c->hit++;
+      hit++;
+    } else if(c->valid - c->hit == 1)
+      c->first = op;
+  }
+
+  printf("%-40s %6s %6s %s\n", "class", "valid", "hit", "first missing");
+  for(i=0;i<nclasses;i++) {
+    class_t *c = &classes[i];
+    if(!all && c->hit == c->valid) continue;
+
+    printf("%-40s %6u %6u", c->name, c->valid, c->hit);
+    if(c->hit != c->valid) printf(" %04x", c->first);
+    printf("\n");
+  }
+
+  if(list) {
+    printf("\nunexecuted opcodes:\n");
+    for(op=0;op<0x10000;op++) {
+      if(!m68k_is_valid_instruction(op, cpu) || COVER_HIT(map, op))
+	continue;
+
+      disassemble(op, cpu, str);
+      printf("%04x %s\n", op, str);
+    }
+  }
+
+  printf("\n%u of %u valid opcodes executed (%.2f%%)\n",
+	 hit, valid, 100.0*hit/valid);
+  return 0;
+}
@@ -0,0 +1,168 @@
+// compare the cycles per instruction of tg68k and musashi. tg68k_run
+// writes a trace of all code fetches if TG68K_CYCLES is set. The same
+// program is run here on musashi, which gives the sequence of executed
+// instructions. The first fetch of each instruction's opcode word marks
+// its start in the tg68k trace
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mem.h"
+#include "m68k_mem.h"
+#include "Musashi/m68k.h"
+
+// stop programs that don't terminate
+#define MAX_INSTRUCTIONS 10000000
+
+#define MAX_CLASSES 1024
+#define WORST       20
+
+typedef struct {
+  unsigned int pc;
+  unsigned long long musashi;   // musashi cycles before this instruction
+  unsigned long long tg68k;     // tg68k clock of the opcode fetch
+} step_t;
+
+static step_t *steps = NULL;
+static int nsteps = 0, max_steps = 0;
+static unsigned long long slice_cycles = 0;
+static int exit_code = -1;
+static int timeout = 0;
+
+typedef struct {
+  char name[16];
+  unsigned long count;
+  unsigned long long musashi, tg68k;
+} class_t;
+
+static class_t classes[MAX_CLASSES];
+static int nclasses = 0;
+
+static void program_exit(int code) {
+  exit_code = code;
+  m68k_end_timeslice();
+}
+
+static void instr_hook(void) {
+  if(nsteps == max_steps) {
+    max_steps = max_steps?2*max_steps:65536;
+    steps = realloc(steps, max_steps * sizeof(step_t));
+  }
+
+  steps[nsteps].pc = m68k_get_reg(NULL, M68K_REG_PC);
+  steps[nsteps].musashi = slice_cycles + m68k_cycles_run();
+  nsteps++;
+
+  if(nsteps >= MAX_INSTRUCTIONS) {
+    timeout = 1;
+    m68k_end_timeslice();
+  }
+}
+
+// find the start of every executed instruction in the tg68k fetch trace.
+// Returns the number of instructions found
+static int match_trace(FILE *f) {
+  unsigned long long clock;
+  unsigned int addr;
+  int i = 0;
+
+  while((i < nsteps) && (fscanf(f, "%llu %x", &clock, &addr) == 2))
+    if(addr == (steps[i].pc & ~1))
+      steps[i++].tg68k = clock;
+
+  return i;
+}
+
+static class_t *get_class(unsigned int pc) {
+  char str[100];
+  int i;
+
+  m68k_disassemble(str, pc, M68K_CPU_TYPE_68020);
+  for(i=0;str[i] && str[i] != ' ' && i<15;i++);
+  str[i] = 0;
+
+  for(i=0;i<nclasses;i++)
+    if(!strcmp(classes[i].name, str))
+      return &classes[i];
+
+  if(nclasses == MAX_CLASSES) return NULL;
+  strcpy(classes[nclasses].name, str);
+  return &classes[nclasses++];
+}
+
+static double ratio(const class_t *c) {
+  return c->musashi?(double)c->tg68k / c->musashi:0;
+}
+
+static int by_ratio(const void *a, const void *b) {
+  double ra = ratio(a), rb = ratio(b);
+  return (ra < rb) - (ra > rb);
+}
+
+static int by_name(const void *a, const void *b) {
+  return strcmp(((const class_t*)a)->name, ((const class_t*)b)->name);
+}
+
+static void print_class(const class_t *c) {
+  printf("%-12s %9lu %10.2f %10.2f %8.2f\n", c->name, c->count,
+	 (double)c->musashi / c->count, (double)c->tg68k / c->count, ratio(c));
+}
+
+int main(int argc, char **argv) {
+  int i, found;
+
+  if(argc != 3) {
+    printf("Usage: m68k_cycles code.bin tg68k_cycles\n");
+    return -1;
+  }
+
+  FILE *trace = fopen(argv[2], "r");
+  if(!trace) { perror(argv[2]); return -1; }
+
+  mem_verbose = 0;
+  mem_init(argv[1]);
+  m68k_init();
+  m68k_set_cpu_type(M68K_CPU_TYPE_68020);
+  m68k_mem_init();
+  m68k_set_instr_hook_callback(instr_hook);
+  mem_exit = program_exit;
+
+  m68k_pulse_reset();
+  while((exit_code < 0) && !timeout)
+    slice_cycles += m68k_execute(100000);
+
+  if(timeout)
+    printf("program didn't exit within %d instructions\n", MAX_INSTRUCTIONS);
+
+  found = match_trace(trace);
+  fclose(trace);
+  if(found < nsteps)
+    printf("only %d of %d instructions found in the tg68k trace\n",
+	   found, nsteps);
+
+  // the last instruction found has no end
+  for(i=0;i<found-1;i++) {
+    class_t *c = get_class(steps[i].pc);
+    if(!c) continue;
+
+    c->count++;
+    c->musashi += steps[i+1].musashi - steps[i].musashi;
+    c->tg68k += steps[i+1].tg68k - steps[i].tg68k;
+  }
+
+  // tg68k clocks are counted with zero wait state memory
+  printf("%-12s %9s %10s %10s %8s\n",
+	 "instruction", "count", "musashi", "tg68k", "ratio");
+
+  qsort(classes, nclasses, sizeof(class_t), by_name);
+  for(i=0;i<nclasses;i++)
+    print_class(&classes[i]);
+
+  printf("\nworst offenders (tg68k clocks per musashi cycle):\n");
+  qsort(classes, nclasses, sizeof(class_t), by_ratio);
+  for(i=0;i<nclasses && i<WORST;i++)
+    print_class(&classes[i]);
+
+  return timeout;
+}
@@ -0,0 +1,85 @@
+// generate random test programs for tg68k/musashi comparison and
+// optionally run them in-process on Musashi
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "mem.h"
+#include "m68k_mem.h"
+#include "gen.h"
+#include "Musashi/m68k.h"
+
+// give up on cases that don't reach the exit address
+#define MAX_CYCLES 100000
+
+static void usage(void) {
+  printf("Usage: m68k_gen [options] seed\n");
+  printf("  -000       generate 68000 code (default is 68020)\n");
+  printf("  -n count   instructions per case (default 16)\n");
+  printf("  -m list    only use mnemonics starting with one of the\n");
+  printf("             comma separated prefixes, e.g. bf,abcd,sbcd\n");
+  printf("  -o file    write the test image\n");
+  printf("  -r cases   run this many cases on Musashi and report the speed\n");
+  exit(-1);
+}
+
+int main(int argc, char **argv) {
+  int cpu = M68K_CPU_TYPE_68020, count = 16, runs = 0;
+  char *mnemonics = NULL, *out = NULL;
+  gen_case_t *c = malloc(sizeof(gen_case_t));
+  int i;
+
+  for(i=1;i<argc-1;i++) {
+    if(!strcmp(argv[i], "-000"))                  cpu = M68K_CPU_TYPE_68000;
+    else if(!strcmp(argv[i], "-n") && i<argc-2)   count = atoi(argv[++i]);
+    else if(!strcmp(argv[i], "-m") && i<argc-2)   mnemonics = argv[++i];
+    else if(!strcmp(argv[i], "-o") && i<argc-2)   out = argv[++i];
+    else if(!strcmp(argv[i], "-r") && i<argc-2)   runs = atoi(argv[++i]);
+    else usage();
+  }
+  if(i != argc-1) usage();
+  unsigned int seed = strtoul(argv[i], NULL, 0);
+
+  mem_verbose = 0;
+  mem_init(NULL);
+  gen_init(cpu, mnemonics);
+
+  if(!runs) {
+    gen_random_case(c, seed, count);
+    gen_emit(c);
+    gen_list(stdout, c);
+    return out?gen_write(out):0;
+  }
+
+  // run the cases in-process, results are only written if RESULT is set
+  if(!result) result = fopen("/dev/null", "w");
+  m68k_init();
+  m68k_set_cpu_type(cpu);
+  m68k_mem_init();
+
+  // all cases of a run share the ram contents of the first one. Only
+  // the pages a case has written are restored before the next one
+  gen_random_case(c, seed, count);
+  gen_emit_data(c);
+  mem_snapshot();
+
+  struct timespec start, now;
+  int timeouts = 0;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  for(i=0;i<runs;i++) {
+    mem_restore();
+    gen_random_case(c, seed+i, count);
+    gen_emit_code(c);
+    if(gen_run(MAX_CYCLES) < 0) timeouts++;
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  double secs = (now.tv_sec - start.tv_sec) + (now.tv_nsec - start.tv_nsec) / 1e9;
+  printf("%d cases in %.3f s = %.0f cases/min, %d timeouts\n",
+	 runs, secs, 60 * runs / secs, timeouts);
+
+  return 0;
+}
@@ -0,0 +1,148 @@
+#include <assert.h>
+#include <stdio.h>
+
+#include "mem.h"
+#include "m68k_mem.h"
+#include "Musashi/m68k.h"
+
+// memory callbacks of Musashi, shared by m68k_run and m68k_gen
+
+// called before every cpu access if set, see m68k_run.c. type is 'R' or
+// 'W', size the access size in bytes and value the data written
+void (*m68k_bus_trace)(char type, unsigned int address, int size, unsigned int value) = NULL;
+
+unsigned int  m68k_read_memory_8(unsigned int address) {
+  if(m68k_bus_trace) m68k_bus_trace('R', address, 1, 0);
+  unsigned char *p = mem_rd_ptr(address, 1);
+  if(p) return p[0];
+
+  unsigned int retval = (address & 1)?
+    (mem_read(address, 3) & 0xff):(mem_read(address, 3) >> 8);
+  // printf("%s(%x)=%x\n", __FUNCTION__, address, retval);
+  return retval;
+}
+
+unsigned int  m68k_read_memory_16(unsigned int address) {
+  if(m68k_bus_trace) m68k_bus_trace('R', address, 2, 0);
+  unsigned char *p = mem_rd_ptr(address, 2);
+  if(p) return MEM_GET16(p);
+
+  unsigned int retval;
+
+  if(address & 1) {
+    retval = 
+      ((mem_read(address-1,3) & 0xff) << 8) +
+      ((mem_read(address+1,3) & 0xff00) >> 8);
+  } else
+    retval = mem_read(address,3);
+
+  //  printf("%s(%x)=%x\n", __FUNCTION__, address, retval);
+  return retval;
+}
+ 
+unsigned int  m68k_read_memory_32(unsigned int address) {
+  if(m68k_bus_trace) m68k_bus_trace('R', address, 4, 0);
+  unsigned char *p = mem_rd_ptr(address, 4);
+  if(p) return MEM_GET32(p);
+
+  unsigned int retval;
+
+  if(address & 1) {
+    retval = 
+      ((mem_read(address-1,3) & 0xff) << 24) +
+      ((mem_read(address+1,3) & 0xffff) << 8) +
+      ((mem_read(address+3,3) & 0xff00) >> 8);
+  } else
+    retval = (mem_read(address,3) << 16) + 
+      mem_read(address+2,3);
+
+  //  printf("%s(%x)=%x\n", __FUNCTION__, address, retval);
+  return retval;
+}
+
+void m68k_write_memory_8(unsigned int address, unsigned int value) {
+  if(m68k_bus_trace) m68k_bus_trace('W', address, 1, value);
+  unsigned char *p = mem_wr_ptr(address, 1);
+  if(p) { p[0] = value; return; }
+
+  //  printf("%s(%x, %x)\n", __FUNCTION__, address, value);
+  if(address & 1) mem_write(address, value & 0xff, 2);
+  else            mem_write(address, value << 8, 1);
+}
+
+void m68k_write_memory_16(unsigned int address, unsigned int value) {
+  if(m68k_bus_trace) m68k_bus_trace('W', address, 2, value);
+  unsigned char *p = mem_wr_ptr(address, 2);
+  if(p) { MEM_PUT16(p, value); return; }
+
+  //  printf("%s(%x, %x)\n", __FUNCTION__, address, value);
+
+  if(address & 1) {
+    mem_write(address-1, (value >> 8) & 0xff, 2);
+    mem_write(address+1, (value << 8) & 0xff00, 1);
+  } else 
+    mem_write(address, value, 3);
+}
+
+void m68k_write_memory_32(unsigned int address, unsigned int value) {
+  if(m68k_bus_trace) m68k_bus_trace('W', address, 4, value);
+  unsigned char *p = mem_wr_ptr(address, 4);
+  if(p) { MEM_PUT32(p, value); return; }
+
+  //  printf("%s(%x, %x)\n", __FUNCTION__, address, value);
+
+  if(address & 1) {
+    mem_write(address-1, (value >> 24) & 0xff, 2);
+    mem_write(address+1, (value >> 8) & 0xffff, 3);
+    mem_write(address+3, (value << 8) & 0xff00, 1);
+  } else {
+    mem_write(address, value >> 16, 3);
+    mem_write(address+2, value & 0xffff, 3);
+  }
+}
+
+// the disassembler must not show up in the memory log or hit io pages
+unsigned int m68k_read_disassembler_8(unsigned int address) {
+  return (address & 1)?(mem_peek(address) & 0xff):(mem_peek(address) >> 8);
+}
+
+unsigned int m68k_read_disassembler_16(unsigned int address) {
+  if(address & 1)
+    return ((mem_peek(address) & 0xff) << 8) | (mem_peek(address+1) >> 8);
+  return mem_peek(address);
+}
+
+unsigned int m68k_read_disassembler_32(unsigned int address) {
+  return (m68k_read_disassembler_16(address) << 16) |
+    m68k_read_disassembler_16(address+2);
+}
+
+#if M68K_DECODE_CACHE
+// only code from the rom image is cached. Pages holding cached code
+// are watched so writes to them invalidate the decode cache
+static int code_cacheable(unsigned int address) {
+  unsigned int end = address + 2*M68K_DECODE_CACHE_WORDS - 1;
+
+  if(mem_verbose || (end & ~MEM_ADDR_MASK) || (end < address))
+    return 0;
+
+  if(!(mem_page[MEM_PAGE(address)].flags & MEM_ROM) ||
+     !(mem_page[MEM_PAGE(end)].flags & MEM_ROM))
+    return 0;
+
+  mem_watch_page(address);
+  mem_watch_page(end);
+  return 1;
+}
+
+static void code_written(unsigned int addr, int size) {
+  m68k_decode_cache_invalidate(addr, size);
+}
+#endif
+
+void m68k_mem_init(void) {
+#if M68K_DECODE_CACHE
+  m68k_set_decode_cache_callback(code_cacheable);
+  mem_watch = code_written;
+#endif
+}
@@ -0,0 +1,10 @@
+#ifndef M68K_MEM_H
+#define M68K_MEM_H
+
+// called before every memory access of the cpu if set
+extern void (*m68k_bus_trace)(char type, unsigned int address, int size, unsigned int value);
+
+// connect Musashi to the memory model in mem.c. Call after m68k_init()
+void m68k_mem_init(void);
+
+#endif // M68K_MEM_H
@@ -0,0 +1,281 @@
+// profile 68k code on Musashi. The instruction hook attributes the cycles
+// of every instruction to its address and follows jsr/bsr and rts/rtd/rtr
+// to build a call graph with inclusive times per routine
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mem.h"
+#include "m68k_mem.h"
+#include "sym.h"
+#include "Musashi/m68k.h"
+
+// code can only run from rom and ram
+#define PROF_RANGE  (RAMBASE+RAMSIZE)
+
+#define MAX_DEPTH   1024
+#define MAX_ROUTINES 4096
+#define MAX_EDGES   16384
+#define HOT_SPOTS   20
+
+static unsigned long long hist_cycles[PROF_RANGE/2];
+static unsigned int hist_count[PROF_RANGE/2];
+static unsigned long long other_cycles = 0;
+
+typedef struct {
+  unsigned int addr;
+  unsigned long calls;
+  unsigned long long inclusive;
+  int active;                   // recursion depth
+} routine_t;
+
+typedef struct {
+  unsigned int caller, callee;  // routine addresses, caller 0 = top level
+  unsigned long calls;
+} edge_t;
+
+typedef struct {
+  routine_t *routine;
+  unsigned int ret;             // return address
+  unsigned long long start;
+} frame_t;
+
+static routine_t routines[MAX_ROUTINES];
+static int nroutines = 0;
+static edge_t edges[MAX_EDGES];
+static int nedges = 0;
+static frame_t stack[MAX_DEPTH];
+static int depth = 0;
+
+static unsigned long long slice_cycles = 0, last_cycles = 0, total = 0;
+static unsigned int last_pc = 0, last_op = 0;
+static int exit_code = -1, started = 0;
+
+static void program_exit(int code) {
+  exit_code = code;
+  m68k_end_timeslice();
+}
+
+static routine_t *get_routine(unsigned int addr) {
+  int i;
+
+  for(i=0;i<nroutines;i++)
+    if(routines[i].addr == addr)
+      return &routines[i];
+
+  if(nroutines == MAX_ROUTINES) return NULL;
+  memset(&routines[nroutines], 0, sizeof(routine_t));
+  routines[nroutines].addr = addr;
+  return &routines[nroutines++];
+}
+
+static void add_edge(unsigned int caller, unsigned int callee) {
+  int i;
+
+  for(i=0;i<nedges;i++)
+    if(edges[i].caller == caller && edges[i].callee == callee) {
+      edges[i].calls++;
+      return;
+    }
+
+  if(nedges == MAX_EDGES) return;
+  edges[nedges].caller = caller;
+  edges[nedges].callee = callee;
+  edges[nedges].calls = 1;
+  nedges++;
+}
+
+static int is_call(unsigned int op) {
+  return ((op & 0xffc0) == 0x4e80) ||          // jsr
+         ((op & 0xff00) == 0x6100);            // bsr
+}
+
+static int is_return(unsigned int op) {
+  return (op == 0x4e75) || (op == 0x4e74) ||   // rts, rtd
+         (op == 0x4e77);                       // rtr
+}
+
+static void call(unsigned int target, unsigned long long now) {
+  routine_t *r = get_routine(target);
+  if(!r || depth == MAX_DEPTH) return;
+
+  add_edge(depth?stack[depth-1].routine->addr:0, target);
+  r->calls++;
+  r->active++;
+
+  // the return address is on top of the stack now
+  stack[depth].routine = r;
+  stack[depth].ret = m68k_read_disassembler_32(m68k_get_reg(NULL, M68K_REG_A7));
+  stack[depth].start = now;
+  depth++;
+}
+
+static void ret(unsigned int pc, unsigned long long now) {
+  int i;
+
+  // unwind to the frame returning here, ignore returns without a call
+  for(i=depth-1;i>=0;i--)
+    if(stack[i].ret == pc)
+      break;
+  if(i < 0) return;
+
+  while(depth > i) {
+    frame_t *f = &stack[--depth];
+    if(!--f->routine->active)
+      f->routine->inclusive += now - f->start;
+  }
+}
+
+static void instr_hook(void) {
+  unsigned int pc = m68k_get_reg(NULL, M68K_REG_PC);
+  unsigned long long now = slice_cycles + m68k_cycles_run();
+
+  if(started) {
+    unsigned long long cycles = now - last_cycles;
+
+    if(last_pc < PROF_RANGE) {
+      hist_cycles[last_pc/2] += cycles;
+      hist_count[last_pc/2]++;
+    } else
+      other_cycles += cycles;
+
+    if(is_call(last_op))         call(pc, now);
+    else if(is_return(last_op))  ret(pc, now);
+  }
+
+  started = 1;
+  last_pc = pc;
+  last_op = m68k_read_disassembler_16(pc);
+  last_cycles = now;
+}
+
+static int by_inclusive(const void *a, const void *b) {
+  unsigned long long ia = ((const routine_t*)a)->inclusive;
+  unsigned long long ib = ((const routine_t*)b)->inclusive;
+  return (ia < ib) - (ia > ib);
+}
+
+static double percent(unsigned long long cycles) {
+  return total?100.0*cycles/total:0;
+}
+
+// cycles per symbol. Without symbols the hot spots and the call graph
+// still show the addresses
+static void flat_profile(void) {
+  unsigned int i, j, offset;
+  typedef struct { const char *name; unsigned long long cycles; unsigned long count; } flat_t;
+  flat_t *flat = calloc(PROF_RANGE/2, sizeof(flat_t));
+  int nflat = 0;
+
+  for(i=0;i<PROF_RANGE/2;i++) {
+    if(!hist_count[i]) continue;
+
+    const char *name = sym_lookup(2*i, &offset);
+    if(!name) name = "(no symbol)";
+
+    for(j=0;j<nflat && strcmp(flat[j].name, name);j++);
+    if(j == nflat) flat[nflat++].name = name;
+    flat[j].cycles += hist_cycles[i];
+    flat[j].count += hist_count[i];
+  }
+
+  // simple selection sort, there are few symbols
+  printf("flat profile:\n%8s %14s %12s  %s\n", "%", "cycles", "instr", "symbol");
+  while(nflat) {
+    int max = 0;
+    for(j=1;j<nflat;j++)
+      if(flat[j].cycles > flat[max].cycles)
+	max = j;
+
+    printf("%7.2f%% %14llu %12lu  %s\n", percent(flat[max].cycles),
+	   flat[max].cycles, flat[max].count, flat[max].name);
+    flat[max] = flat[--nflat];
+  }
+  free(flat);
+}
+
+static void hot_spots(void) {
+  char str[100];
+  int n;
+
+  printf("\nhot spots:\n%8s %14s %12s  %s\n", "%", "cycles", "count", "address");
+  for(n=0;n<HOT_SPOTS;n++) {
+    unsigned int i, max = 0;
+    for(i=1;i<PROF_RANGE/2;i++)
+      if(hist_cycles[i] > hist_cycles[max])
+	max = i;
+    if(!hist_cycles[max]) break;
+
+    m68k_disassemble(str, 2*max, M68K_CPU_TYPE_68020);
+    printf("%7.2f%% %14llu %12u  %-24s %s\n", percent(hist_cycles[max]),
+	   hist_cycles[max], hist_count[max], sym_format(2*max), str);
+    hist_cycles[max] = 0;
+  }
+}
+
+static void call_graph(void) {
+  int i;
+
+  qsort(routines, nroutines, sizeof(routine_t), by_inclusive);
+
+  printf("\ninclusive time per routine:\n%8s %14s %10s  %s\n",
+	 "%", "cycles", "calls", "routine");
+  for(i=0;i<nroutines;i++)
+    printf("%7.2f%% %14llu %10lu  %s\n", percent(routines[i].inclusive),
+	   routines[i].inclusive, routines[i].calls, sym_format(routines[i].addr));
+
+  printf("\ncall graph:\n%10s  %s\n", "calls", "caller -> callee");
+  for(i=0;i<nedges;i++) {
+    printf("%10lu  %s -> ", edges[i].calls,
+	   edges[i].caller?sym_format(edges[i].caller):"(top)");
+    printf("%s\n", sym_format(edges[i].callee));
+  }
+}
+
+int main(int argc, char **argv) {
+  unsigned long long max_cycles = 0;
+  int i;
+
+  for(i=1;i<argc-1;i++) {
+    if(!strcmp(argv[i], "-s") && i<argc-2)        sym_load(argv[++i]);
+    else if(!strcmp(argv[i], "-c") && i<argc-2)   max_cycles = strtoull(argv[++i], NULL, 0);
+    else break;
+  }
+
+  if(i != argc-1) {
+    printf("Usage: m68k_prof [-s symbols] [-c max_cycles] code.bin\n");
+    printf("  symbols can be a vasm listing (-L) or \"address name\" lines\n");
+    return -1;
+  }
+
+  mem_verbose = 0;
+  mem_init(argv[i]);
+  m68k_init();
+  m68k_set_cpu_type(M68K_CPU_TYPE_68020);
+  m68k_mem_init();
+  m68k_set_instr_hook_callback(instr_hook);
+  mem_exit = program_exit;
+
+  m68k_pulse_reset();
+  while(exit_code < 0 && (!max_cycles || slice_cycles < max_cycles))
+    slice_cycles += m68k_execute(100000);
+
+  // the last instruction (usually the exit write) isn't counted. Open
+  // calls end here
+  total = last_cycles;
+  while(depth) {
+    frame_t *f = &stack[--depth];
+    if(!--f->routine->active)
+      f->routine->inclusive += total - f->start;
+  }
+
+  printf("%llu cycles, exit code %d\n", total, exit_code);
+  if(other_cycles)
+    printf("%llu cycles outside of rom and ram\n", other_cycles);
+  printf("\n");
+  flat_profile();
+  hot_spots();
+  call_graph();
+  return 0;
+}
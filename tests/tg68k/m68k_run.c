@@ -1,79 +1,118 @@
 #include <assert.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
 
 #include "mem.h"
+#include "m68k_mem.h"
+#include "snapshot.h"
+#include "cover.h"
 #include "Musashi/m68k.h"
 
-unsigned int  m68k_read_memory_8(unsigned int address) {
-  unsigned int retval = (address & 1)?
-    (mem_read(address, 3) & 0xff):(mem_read(address, 3) >> 8);
-  // printf("%s(%x)=%x\n", __FUNCTION__, address, retval);
-  return retval;
+// benchmark mode: run in large timeslices and report the speed at exit
+static struct timespec bench_start;
+static unsigned long long bench_instructions = 0;
+
+static void bench_report(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  double secs = (now.tv_sec - bench_start.tv_sec) +
+    (now.tv_nsec - bench_start.tv_nsec) / 1e9;
+  unsigned long long instr = bench_instructions + m68k_instructions_run();
+
+  printf("%llu instructions in %.3f s = %.2f MIPS\n",
+	 instr, secs, instr / secs / 1e6);
 }
 
-unsigned int  m68k_read_memory_16(unsigned int address) {
-  unsigned int retval;
+// coverage mode: merge the executed opcodes into a bitmap file at exit
+static char *coverage = NULL;
+
+// (needs a cpu core built with M68K_COVERAGE, see m68k_run_cov)
+static void coverage_save(void) {
+  unsigned char map[COVER_BYTES] = { 0 };
+  unsigned int op;
+
+  cover_load(coverage, map);
+  for(op=0;op<0x10000;op++)
+    if(m68k_coverage_count(op))
+      COVER_SET(map, op);
+  cover_save(coverage, map);
+}
 
-  if(address & 1) {
-    retval = 
-      ((mem_read(address-1,3) & 0xff) << 8) +
-      ((mem_read(address+1,3) & 0xff00) >> 8);
-  } else
-    retval = mem_read(address,3);
+// bus trace: one line per word access "F|R|W address ds [data]" with
+// ds 1 upper, 2 lower, 3 both bytes. Code fetches are told from data
+// reads by the pc, which Musashi advances before it reads the opcode or
+// extension words. With the decode cache cached code isn't read again,
+// so those fetches are missing
+static FILE *bus_trace_file = NULL;
 
-  //  printf("%s(%x)=%x\n", __FUNCTION__, address, retval);
-  return retval;
+static int is_fetch(unsigned int address, int size) {
+  return address == m68k_get_reg(NULL, M68K_REG_PC) - size;
 }
- 
-unsigned int  m68k_read_memory_32(unsigned int address) {
-  unsigned int retval;
-
-  if(address & 1) {
-    retval = 
-      ((mem_read(address-1,3) & 0xff) << 24) +
-      ((mem_read(address+1,3) & 0xffff) << 8) +
-      ((mem_read(address+3,3) & 0xff00) >> 8);
-  } else
-    retval = (mem_read(address,3) << 16) + 
-      mem_read(address+2,3);
-
-  //  printf("%s(%x)=%x\n", __FUNCTION__, address, retval);
-  return retval;
+
+static void bus_trace_word(char type, unsigned int address, int ds, unsigned int data) {
+  if(type == 'W')
+    fprintf(bus_trace_file, "W %06x %d %04x\n", address & 0xfffffe, ds, data & 0xffff);
+  else
+    fprintf(bus_trace_file, "%c %06x %d\n", type, address & 0xfffffe, ds);
 }
 
-void m68k_write_memory_8(unsigned int address, unsigned int value) {
-  //  printf("%s(%x, %x)\n", __FUNCTION__, address, value);
-  if(address & 1) mem_write(address, value & 0xff, 2);
-  else            mem_write(address, value << 8, 1);
+static void bus_trace(char type, unsigned int address, int size, unsigned int value) {
+  if(size == 1) {
+    bus_trace_word(type, address, (address & 1)?2:1, (value & 0xff) * 0x101);
+    return;
+  }
+
+  if(type == 'R' && is_fetch(address, size)) type = 'F';
+  if(size == 4) {
+    bus_trace_word(type, address, 3, value >> 16);
+    address += 2;
+  }
+  bus_trace_word(type, address, 3, value);
 }
 
-void m68k_write_memory_16(unsigned int address, unsigned int value) {
-  //  printf("%s(%x, %x)\n", __FUNCTION__, address, value);
+// repeat mode: run the program several times from a snapshot
+static int exit_code = -1;
 
-  if(address & 1) {
-    printf("<<<<<<<<<<<<<<<< untested >>>>>>>>>>>>>>>>\n");
-    mem_write(address-1, value & 0xff00, 1);
-    mem_write(address+1, value & 0xff, 2);
-  } else 
-    mem_write(address, value, 3);
+static void program_exit(int code) {
+  exit_code = code;
+  m68k_end_timeslice();
 }
 
-void m68k_write_memory_32(unsigned int address, unsigned int value) {
-  //  printf("%s(%x, %x)\n", __FUNCTION__, address, value);
+static int repeat(int runs) {
+  unsigned long long pages = 0;
+  struct timespec start, now;
+  int i, first = -1;
+
+  mem_exit = program_exit;
+  snapshot_take();
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for(i=0;i<runs;i++) {
+    if(i) pages += snapshot_restore();
+    if(result) rewind(result);
 
-  if(address & 1) {
-    mem_write(address-1, (value >> 24) & 0xff, 2);
-    mem_write(address+1, (value >> 8) & 0xffff, 3);
-    mem_write(address+3, (value << 8) & 0xff00, 1);
-  } else {
-    mem_write(address, value >> 16, 3);
-    mem_write(address+2, value & 0xffff, 3);
+    exit_code = -1;
+    while(exit_code < 0)
+      m68k_execute(100000);
+
+    if(!i) first = exit_code;
+    if(exit_code != first)
+      printf("Run %d terminated with error code %d\n", i, exit_code);
   }
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  double secs = (now.tv_sec - start.tv_sec) + (now.tv_nsec - start.tv_nsec) / 1e9;
+  printf("%d runs in %.3f s = %.0f runs/s, %.1f pages restored per run\n",
+	 runs, secs, runs / secs, runs>1?(double)pages/(runs-1):0.0);
+
+  if(!first) printf("Program terminated successful\n");
+  else       printf("Program terminated with error code %d\n", first);
+  return first;
 }
 
 int main(int argc, char **argv) {
-  int i;
-
   if(argc != 2) {
     printf("Usage: m68k_run code.bin\n");
     return -1;
@@ -81,9 +120,34 @@ int main(int argc, char **argv) {
 
   mem_init(argv[1]);
   m68k_init();
-  m68k_set_cpu_type(M68K_CPU_TYPE_68020);
+  m68k_set_cpu_type((mem_cpu_type() == 68000)?M68K_CPU_TYPE_68000:M68K_CPU_TYPE_68020);
+  m68k_mem_init();
   m68k_pulse_reset();
 
+  // e.g. for the cache testbench in tests/verilator/cache
+  if(getenv("BUSTRACE")) {
+    if((bus_trace_file = fopen(getenv("BUSTRACE"), "w")))
+      m68k_bus_trace = bus_trace;
+    else
+      perror(getenv("BUSTRACE"));
+  }
+
+  if((coverage = getenv("COVERAGE")))
+    atexit(coverage_save);
+
+  if(getenv("REPEAT"))
+    return repeat(atoi(getenv("REPEAT")));
+
+  if(getenv("BENCH")) {
+    clock_gettime(CLOCK_MONOTONIC, &bench_start);
+    atexit(bench_report);
+
+    while(1) {
+      m68k_execute(100000);
+      bench_instructions += m68k_instructions_run();
+    }
+  }
+
   while(1)
     m68k_execute(0);
 
@@ -1,33 +1,145 @@
 #include <stdio.h>
 #include <assert.h>
 #include <stdlib.h>
+#include <string.h>
 #include "mem.h"
 
-#define ROMSIZE 65536
-#define RAMSIZE 65536
-
-#define ROMBASE 0x0
-#define RAMBASE 0x10000
-
-#define VERBOSE
-
 FILE *result = NULL;
 
+// log every memory access and accesses to unmapped addresses to stdout
+// unless QUIET is set
+int mem_verbose = 1;
+
 // this should be the same as the VHDL counterpart
 unsigned char code[ROMSIZE];
 unsigned char ram[RAMSIZE];
 
+mem_page_t mem_page[MEM_PAGES];
+unsigned char *mem_rd_page[MEM_PAGES];
+unsigned char *mem_wr_page[MEM_PAGES];
+
+// log of all writes set via WRITES, used to find the first bus cycle
+// where two runs diverge. mem_clock is the time stamp for the log
+static FILE *mem_trace = NULL;
+unsigned long mem_clock = 0;
+
+void (*mem_watch)(unsigned int addr, int size) = NULL;
+void (*mem_exit)(int code) = NULL;
+
+// pages written since the last snapshot
+static unsigned int mem_dirty[MEM_PAGES];
+static int mem_dirty_pages = 0;
+
+// dump area used to export hex numbers
+static void result_write(unsigned int addr, unsigned int data, int ds) {
+  // a 68000 only drives 24 address bits and hits the area at 0xffee42
+  unsigned int offset = (addr - RESULT_ADDR) & 0xffffff;
+  if(result && (offset < 32*4)) {
+    char *name[] = { "D", "A", "X", "." };
+    int reg = offset/2;
+    if(reg == 32) {
+      fprintf(result, "SR %04x XNZVC\n", data);
+
+    } else
+      fprintf(result, "%s%d.%c:%04x\n",
+	      name[reg>>4],(reg>>1)&7, (reg&1)?'l':'h', data);
+    return;
+  }
+
+  if(mem_verbose) printf("suspicious address %x\n", addr);
+}
+
+static unsigned int result_read(unsigned int addr, int ds) {
+  if(mem_verbose) printf("suspicious address!!!\n");
+  return 0;
+}
+
+static void exit_write(unsigned int addr, unsigned int data, int ds) {
+  if(addr == EXIT_ADDR) {
+    if(mem_exit) {
+      mem_exit(data);
+      return;
+    }
+
+    if(!data) printf("Program terminated successful\n");
+    else      printf("Program terminated with error code %d\n", data);
+    exit(data);
+  }
+
+  if(mem_verbose) printf("suspicious address %x\n", addr);
+}
+
+static unsigned int exit_read(unsigned int addr, int ds) {
+  if(!mem_verbose)
+    return 0;
+
+  if(addr == EXIT_ADDR)
+    printf("beefed read??\n");
+  else
+    printf("suspicious address!!!\n");
+  return 0;
+}
+
+static const mem_io_t result_io = { result_read, result_write };
+static const mem_io_t exit_io = { exit_read, exit_write };
+
+static void mem_map(unsigned int base, unsigned int size, unsigned char *ptr,
+		    unsigned int flags) {
+  unsigned int i;
+  for(i=0;i<size;i+=MEM_PAGE_SIZE) {
+    mem_page_t *p = &mem_page[MEM_PAGE(base+i)];
+    p->ptr = ptr + i;
+    p->io = NULL;
+    p->flags = flags;
+
+    // direct access bypasses the memory log and the write log
+    if(!mem_verbose)
+      mem_rd_page[MEM_PAGE(base+i)] = p->ptr;
+    if(!mem_verbose && !mem_trace)
+      mem_wr_page[MEM_PAGE(base+i)] = p->ptr;
+  }
+}
+
+static void mem_map_io(unsigned int addr, const mem_io_t *io) {
+  mem_page[MEM_PAGE(addr)].ptr = NULL;
+  mem_page[MEM_PAGE(addr)].io = io;
+  mem_page[MEM_PAGE(addr)].flags = 0;
+  mem_rd_page[MEM_PAGE(addr)] = mem_wr_page[MEM_PAGE(addr)] = NULL;
+}
+
 void mem_init(char *name) {
-  FILE *f = fopen(name, "rb");
-  if(!f) { printf("unable to load %s\n", name); exit(-1); }
+  char *p;
+
+  if(getenv("QUIET"))
+    mem_verbose = 0;
+
+  // without a name the caller fills code and ram itself
+  if(name) {
+    FILE *f = fopen(name, "rb");
+    if(!f) { printf("unable to load %s\n", name); exit(-1); }
+
+    int r = fread(code, 1, sizeof(code), f);
+    printf("loaded %d bytes code\n", r);
 
-  int r = fread(code, 1, sizeof(code), f);
-  printf("loaded %d bytes code\n", r);
+    // images bigger than the rom also bring initial ram contents
+    r = fread(ram, 1, sizeof(ram), f);
+    if(r > 0) printf("loaded %d bytes ram\n", r);
 
-  fclose(f);
+    fclose(f);
+  }
+
+  if((p=getenv("WRITES"))) {
+    mem_trace = fopen(p, "w");
+    if(!mem_trace)
+      perror(p);
+  }
+
+  mem_map(ROMBASE, ROMSIZE, code, MEM_ROM);
+  mem_map(RAMBASE, RAMSIZE, ram, 0);
+  mem_map_io(RESULT_ADDR, &result_io);
+  mem_map_io(EXIT_ADDR, &exit_io);
 
   // try to open the result file
-  char *p;
   if((p=getenv("RESULT"))) {
     printf("Writing restult to file %s\n", p);
     result = fopen(p, "w");
@@ -37,71 +149,113 @@ void mem_init(char *name) {
   }
 }
 
-unsigned char *addr_ptr(unsigned int address) {
-  if((address >= ROMBASE) && (address < ROMBASE+ROMSIZE))
-    return code + address - ROMBASE;
+// cpu the program is meant for, CPU_TYPE=68000 or 68020 (default)
+int mem_cpu_type(void) {
+  char *p = getenv("CPU_TYPE");
+  return (p && !strcmp(p, "68000"))?68000:68020;
+}
 
-  if((address >= RAMBASE) && (address < RAMBASE+RAMSIZE))
-    return ram + address - RAMBASE;
+// side effect free read of a word for disassemblers and tools
+unsigned int mem_peek(unsigned int addr) {
+  unsigned char *p = mem_page[MEM_PAGE(addr)].ptr;
+  if(!p) return 0;
 
-  return NULL;
+  p += addr & MEM_PAGE_MASK & ~1;
+  return MEM_GET16(p);
 }
 
 // ignore ds when reading
 unsigned int mem_read(unsigned int addr, int ds) {
-#ifdef VERBOSE
-  printf("mem_read(0x%08x,%d) = ", addr, ds);
-#endif
+  mem_page_t *p = &mem_page[MEM_PAGE(addr)];
 
-  if(addr == 0xbeefed) {
-    printf("beefed read??\n");
-    return 0;
-  }
+  if(mem_verbose)
+    printf("mem_read(0x%08x,%d) = ", addr, ds);
 
-  unsigned char *a = addr_ptr(addr & 0xffffffe);
-  if(!a) { 
-    printf("suspicious address!!!\n");
+  if(p->io)
+    return p->io->read(addr, ds);
+
+  if(!p->ptr) {
+    if(mem_verbose) printf("suspicious address!!!\n");
     return 0;
   }
 
+  unsigned char *a = p->ptr + (addr & MEM_PAGE_MASK & ~1);
   unsigned int retval = 256ul * a[0] + a[1];
-#ifdef VERBOSE
-  printf("%04x\n", retval);
-#endif
+  if(mem_verbose)
+    printf("%04x\n", retval);
   return retval;
 }
 
-// ignore ds when reading
 void mem_write(unsigned int addr, unsigned int data, int ds) {
-#ifdef VERBOSE
-  printf("mem_write(0x%08x,%d) = %04x\n", addr, ds, data);
-#endif
+  mem_page_t *p = &mem_page[MEM_PAGE(addr)];
 
-  // dump area used to export hex numbers 
-  if(result && (addr >= 0xc0ffee42) && (addr < 0xc0ffee42+32*4)) {
-    char *name[] = { "D", "A", "X", "." };
-    int reg = (addr - 0xc0ffee42)/2;
-    if(reg == 32) {
-      fprintf(result, "SR %04x XNZVC\n", data);
+  if(mem_verbose)
+    printf("mem_write(0x%08x,%d) = %04x\n", addr, ds, data);
 
-    } else 
-      fprintf(result, "%s%d.%c:%04x\n",
-	      name[reg>>4],(reg>>1)&7, (reg&1)?'l':'h', data);
+  if(mem_trace)
+    fprintf(mem_trace, "%lu %08x %04x %d\n", mem_clock, addr, data, ds);
+
+  if(p->io) {
+    p->io->write(addr, data, ds);
     return;
   }
-    
-  if(addr == 0xbeefed) {
-    if(!data) printf("Program terminated successful\n");
-    else      printf("Program terminated with error code %d\n", data);
-    exit(data);
-  }
 
-  unsigned char *a = addr_ptr(addr & 0xffffffe);
-  if(!a) { 
-    printf("suspicious address %x\n", addr);
+  if(!p->ptr) {
+    if(mem_verbose) printf("suspicious address %x\n", addr);
     return;
   }
 
+  unsigned char *a = p->ptr + (addr & MEM_PAGE_MASK & ~1);
   if(ds&1) a[0] = data >> 8;
   if(ds&2) a[1] = data & 0xff;
+
+  if((p->flags & MEM_WATCH) && mem_watch)
+    mem_watch(addr & ~1, 2);
+
+  // first write since the snapshot. Further writes can go direct
+  if(p->snap && !(p->flags & MEM_DIRTY)) {
+    p->flags |= MEM_DIRTY;
+    mem_dirty[mem_dirty_pages++] = MEM_PAGE(addr);
+    if(!mem_verbose && !mem_trace && !(p->flags & MEM_WATCH))
+      mem_wr_page[MEM_PAGE(addr)] = p->ptr;
+  }
+}
+
+// route all writes to this page through mem_write() and mem_watch
+void mem_watch_page(unsigned int addr) {
+  mem_page[MEM_PAGE(addr)].flags |= MEM_WATCH;
+  mem_wr_page[MEM_PAGE(addr)] = NULL;
+}
+
+// save the contents of all memory pages. Pages stay write protected
+// until their first write so mem_restore() knows which ones to copy
+void mem_snapshot(void) {
+  unsigned int i;
+  for(i=0;i<MEM_PAGES;i++) {
+    mem_page_t *p = &mem_page[i];
+    if(!p->ptr) continue;
+
+    if(!p->snap) p->snap = malloc(MEM_PAGE_SIZE);
+    memcpy(p->snap, p->ptr, MEM_PAGE_SIZE);
+    p->flags &= ~MEM_DIRTY;
+    mem_wr_page[i] = NULL;
+  }
+  mem_dirty_pages = 0;
+}
+
+// bring back all pages written since the last snapshot. Returns the
+// number of pages copied
+int mem_restore(void) {
+  int i, n = mem_dirty_pages;
+  for(i=0;i<n;i++) {
+    mem_page_t *p = &mem_page[mem_dirty[i]];
+    memcpy(p->ptr, p->snap, MEM_PAGE_SIZE);
+    p->flags &= ~MEM_DIRTY;
+    mem_wr_page[mem_dirty[i]] = NULL;
+
+    if((p->flags & MEM_WATCH) && mem_watch)
+      mem_watch(mem_dirty[i] << MEM_PAGE_BITS, MEM_PAGE_SIZE);
+  }
+  mem_dirty_pages = 0;
+  return n;
 }
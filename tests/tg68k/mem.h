@@ -1,8 +1,99 @@
 #ifndef MEM_H
 #define MEM_H
 
+#include <stdio.h>
+
+#define ROMSIZE 65536
+#define RAMSIZE 65536
+
+#define ROMBASE 0x0
+#define RAMBASE 0x10000
+
+// special addresses used by the test programs
+#define RESULT_ADDR 0xc0ffee42
+#define EXIT_ADDR   0xbeefed
+
+// the memory map is split into 4k pages. Only the lower 28 address bits
+// are decoded, so the whole map fits into 64k page entries
+#define MEM_PAGE_BITS  12
+#define MEM_PAGE_SIZE  (1<<MEM_PAGE_BITS)
+#define MEM_PAGE_MASK  (MEM_PAGE_SIZE-1)
+#define MEM_ADDR_MASK  0x0fffffff
+#define MEM_PAGES      ((MEM_ADDR_MASK+1)>>MEM_PAGE_BITS)
+
+#define MEM_PAGE(a)    (((a) & MEM_ADDR_MASK) >> MEM_PAGE_BITS)
+
+// io pages get the full (unmasked) address and the bus data strobes
+typedef struct {
+  unsigned int (*read)(unsigned int addr, int ds);
+  void (*write)(unsigned int addr, unsigned int data, int ds);
+} mem_io_t;
+
+// page flags
+#define MEM_ROM     1     // page maps the code image
+#define MEM_WATCH   2     // writes are reported through mem_watch
+#define MEM_DIRTY   4     // page was written since the last snapshot
+
+typedef struct {
+  unsigned char *ptr;     // host memory backing this page or NULL
+  const mem_io_t *io;     // io handler or NULL
+  unsigned int flags;
+  unsigned char *snap;    // page contents at the last snapshot or NULL
+} mem_page_t;
+
+extern mem_page_t mem_page[MEM_PAGES];
+
+// this should be the same as the VHDL counterpart
+extern unsigned char code[ROMSIZE];
+extern unsigned char ram[RAMSIZE];
+
+// host pointers for direct access. These are NULL for io and unmapped
+// pages and for all pages while the memory log is enabled. Writes also
+// aren't direct while the WRITES log is enabled
+extern unsigned char *mem_rd_page[MEM_PAGES];
+extern unsigned char *mem_wr_page[MEM_PAGES];
+
+extern int mem_verbose;
+
+// time stamp for the WRITES log, e.g. the cpu clock
+extern unsigned long mem_clock;
+
+// called after each write to a watched page
+extern void (*mem_watch)(unsigned int addr, int size);
+
+// called instead of exit() when the program writes to the exit address
+extern void (*mem_exit)(int code);
+
+// register dump file set via RESULT
+extern FILE *result;
+
 void mem_init(char *name);
 unsigned int mem_read(unsigned int addr, int ds);
+unsigned int mem_peek(unsigned int addr);
+int mem_cpu_type(void);
 void mem_write(unsigned int addr, unsigned int data, int ds);
+void mem_watch_page(unsigned int addr);
+void mem_snapshot(void);
+int mem_restore(void);
+
+// return a host pointer if an access of size bytes can be done directly
+static inline unsigned char *mem_rd_ptr(unsigned int addr, int size) {
+  unsigned char *p = mem_rd_page[MEM_PAGE(addr)];
+  if(!p || (addr & MEM_PAGE_MASK) > (unsigned int)(MEM_PAGE_SIZE-size)) return NULL;
+  return p + (addr & MEM_PAGE_MASK);
+}
+
+static inline unsigned char *mem_wr_ptr(unsigned int addr, int size) {
+  unsigned char *p = mem_wr_page[MEM_PAGE(addr)];
+  if(!p || (addr & MEM_PAGE_MASK) > (unsigned int)(MEM_PAGE_SIZE-size)) return NULL;
+  return p + (addr & MEM_PAGE_MASK);
+}
+
+// memory is stored in 68k (big endian) byte order
+#define MEM_GET16(p)  (((p)[0]<<8) | (p)[1])
+#define MEM_GET32(p)  (((unsigned int)(p)[0]<<24) | ((p)[1]<<16) | ((p)[2]<<8) | (p)[3])
+#define MEM_PUT16(p,v) do { (p)[0] = (v)>>8;  (p)[1] = (v); } while(0)
+#define MEM_PUT32(p,v) do { (p)[0] = (v)>>24; (p)[1] = (v)>>16; \
+                            (p)[2] = (v)>>8;  (p)[3] = (v); } while(0)
 
 #endif // MEM_H
@@ -12,6 +12,10 @@ package mem_if is
   );
     attribute foreign of mem_if_c :
       procedure is "VHPIDIRECT mem_if_c";
+
+  function mem_if_cpu return integer;
+    attribute foreign of mem_if_cpu :
+      function is "VHPIDIRECT mem_if_cpu";
 end mem_if;
 
 package body mem_if is
@@ -26,4 +30,10 @@ package body mem_if is
   begin
     assert false report "VHPI" severity failure;
   end mem_if_c;
+
+  function mem_if_cpu return integer is
+  begin
+    assert false report "VHPI" severity failure;
+    return 3;
+  end mem_if_cpu;
 end mem_if;
@@ -1,6 +1,8 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
+#include <time.h>
 
 // #define DEBUG
 
@@ -18,39 +20,99 @@
 
 unsigned char chr[] = { 'U','X','0','1','Z','W','L','H','-' };
 
+// cpu clocks since start and an optional trace of all code fetches
+// (clock and address) for cycle timing analysis via TG68K_CYCLES
+static unsigned long clocks = 0;
+static FILE *cycles = NULL;
+static struct timespec start;
+
+// std_logic chars for every byte value, msb first
+static char sulv_byte[256][8];
+
+// std_logic values '1' (3) and 'H' (7) are the only ones with both
+// lower bits set. Convert 8 of them at once into a byte, msb first
+static inline unsigned int sulv_pack8(const char *v) {
+  uint64_t w;
+  memcpy(&w, v, 8);
+  w &= (w >> 1) & 0x0101010101010101ull;
+  return (w * 0x8040201008040201ull) >> 56;
+}
+
+static unsigned int sulv_pack(const char *v, int bytes) {
+  unsigned int r = 0;
+  while(bytes--) {
+    r = (r << 8) | sulv_pack8(v);
+    v += 8;
+  }
+  return r;
+}
+
+static void cycles_report(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  double secs = (now.tv_sec - start.tv_sec) + (now.tv_nsec - start.tv_nsec) / 1e9;
+  printf("%lu clocks in %.3f s = %.0f cycles/s\n", clocks, secs, clocks / secs);
+}
+
+static void mem_if_init(void) {
+  int i, j;
+
+  // check if a file name was given
+  if(getenv("TG68K_BIN"))
+    mem_init(getenv("TG68K_BIN"));
+  else {
+    fprintf(stderr, "Please specify a bin file via TG68K_BIN\n");
+    exit(-1);
+  }
+
+  if(getenv("TG68K_CYCLES")) {
+    cycles = fopen(getenv("TG68K_CYCLES"), "w");
+    if(!cycles) perror(getenv("TG68K_CYCLES"));
+  }
+
+  for(i=0;i<256;i++)
+    for(j=0;j<8;j++)
+      sulv_byte[i][j] = (i & (0x80>>j))?SULV_1:SULV_0;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  atexit(cycles_report);
+}
+
+// drives the CPU input of the kernel: 0 for the 68000, 3 for the 68020
+int mem_if_cpu(void) {
+  return (mem_cpu_type() == 68000)?0:3;
+}
+
 void mem_if_c(char clk, char bs[2], char ds[2], char addr[32], char din[16], char dout[16]) {
   static unsigned int data_out = 0;
   static char init = 0;
   static char last_clk = 0;
-  static unsigned int last_addr = 0xffffffff;
-  static unsigned short last_data;
+  static char cycles_clk = 0;
 
-  int busstate = ((bs[1]==SULV_1)?1:0) + ((bs[0]==SULV_1)?2:0);
-  int dstrobe = ((ds[1]==SULV_1)?1:0) + ((ds[0]==SULV_1)?2:0);
-  char wr = (busstate == 3)?SULV_1:SULV_0;
+  if(!init) {
+    mem_if_init();
+    init=1;
+  }
+
+  // count all clocks, also those without bus access
+  if(clk != cycles_clk) {
+    cycles_clk = clk;
+    if(clk != SULV_1) clocks++;
+  }
 
   // default: restore previous data_out
-  int i;
-  for(i=0;i<16;i++)
-    dout[i] = (data_out & (0x8000>>i))?SULV_1:SULV_0;
-  
+  memcpy(dout, sulv_byte[data_out >> 8], 8);
+  memcpy(dout+8, sulv_byte[data_out & 0xff], 8);
+
+  // idle cycles leave last_clk alone, so the edge check below only
+  // sees the calls with a bus cycle
+  int busstate = ((bs[1]==SULV_1)?1:0) + ((bs[0]==SULV_1)?2:0);
   if(busstate == 1)
     return;
 
-  if(!init) {
-    // check if a file name was given
-    if(getenv("TG68K_BIN"))
-      mem_init(getenv("TG68K_BIN"));
-    else {
-      fprintf(stderr, "Please specify a bin file via TG68K_BIN\n");
-      exit(-1);
-    }
-    
-    init=1;
-  }
-    
   // only do something if clock changes
-  if(clk == last_clk) 
+  if(clk == last_clk)
     return;
 
   last_clk = clk;
@@ -58,28 +120,23 @@ void mem_if_c(char clk, char bs[2], char ds[2], char addr[32], char din[16], cha
   // only react on falling clk edge
   if(clk == SULV_1) return;
 
-  unsigned int a = 0;
-  for(i=0;i<32;i++) {
-    a <<= 1;
-    if((addr[i] == SULV_1)||(addr[i] == SULV_H))
-      a |= 1;
-  }
+  int dstrobe = ((ds[1]==SULV_1)?1:0) + ((ds[0]==SULV_1)?2:0);
+  unsigned int a = sulv_pack(addr, 4);
 
 #ifdef DEBUG
   printf("mem(%08x/%d/%d) = ", a, dstrobe, busstate);
 #endif
 
-  if(wr == SULV_1) {
-    unsigned int d = 0;
-    for(i=0;i<16;i++) {
-      d <<= 1;
-      if((din[i] == SULV_1)||(din[i] == SULV_H))
-	d |= 1;
-    }
+  if(cycles && (busstate == 0))
+    fprintf(cycles, "%lu %08x\n", clocks, a);
+
+  if(busstate == 3) {
+    unsigned int d = sulv_pack(din, 2);
 
 #ifdef DEBUG    
     printf("WRITE %x\n", d);
 #endif
+    mem_clock = clocks;
     mem_write(a, d, dstrobe);
   } else {
     //    exit(-1);
@@ -89,9 +146,8 @@ void mem_if_c(char clk, char bs[2], char ds[2], char addr[32], char din[16], cha
     printf("READ %x\n", d16);
 #endif
 
-    for(i=0;i<16;i++)
-      dout[i] = (d16 & (0x8000>>i))?SULV_1:SULV_0;
-
+    memcpy(dout, sulv_byte[d16 >> 8], 8);
+    memcpy(dout+8, sulv_byte[d16 & 0xff], 8);
     data_out = d16;
   }
 }
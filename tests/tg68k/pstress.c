@@ -0,0 +1,335 @@
+// parallel differential stress test. Keeps several tg68k/musashi pairs
+// busy with random cases from gen.c. Failing cases are shrunk and stored
+// in a corpus directory
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <time.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include "mem.h"
+#include "m68k_mem.h"
+#include "gen.h"
+#include "Musashi/m68k.h"
+
+// cases musashi doesn't finish within this are skipped
+#define MAX_CYCLES 100000
+
+#define MAX_JOBS   64
+
+// tg68k_run gets the case via TG68K_BIN and writes its registers to RESULT.
+// The cpu type is passed in CPU_TYPE. Waves are off, failing cases can be replayed with replay.sh (-w)
+#define TG68K_CMD  "./tg68k_run --ieee-asserts=disable --stop-time=10ms"
+
+// per worker statistics, shared with the parent
+typedef struct {
+  unsigned long cases;
+  unsigned long timeouts;
+  unsigned long failures;
+} stats_t;
+
+static stats_t *stats;
+static const char *cmd = TG68K_CMD;
+static const char *corpus = "corpus";
+static int replay = 0;
+static volatile sig_atomic_t stop = 0;
+
+static void on_signal(int sig) {
+  stop = 1;
+}
+
+static void usage(void) {
+  printf("Usage: pstress [options] seed\n");
+  printf("  -000       generate 68000 code (default is 68020)\n");
+  printf("  -j jobs    number of parallel workers (default: all cores)\n");
+  printf("  -n count   instructions per case (default 16)\n");
+  printf("  -m list    only use mnemonics starting with one of the\n");
+  printf("             comma separated prefixes, e.g. bf,abcd,sbcd\n");
+  printf("  -c cases   stop after this many cases (default: run forever)\n");
+  printf("  -d dir     corpus directory for failing cases (default corpus)\n");
+  printf("  -w         replay failing cases with waves via replay.sh\n");
+  printf("  -t cmd     tg68k command, gets TG68K_BIN, RESULT and CPU_TYPE in its\n");
+  printf("             environment (default \"%s\")\n", TG68K_CMD);
+  exit(-1);
+}
+
+// compare two result files, returns 0 if both are identical
+static int file_diff(const char *a, const char *b) {
+  FILE *fa = fopen(a, "rb"), *fb = fopen(b, "rb");
+  int ca, cb, ret = 1;
+
+  if(fa && fb) {
+    do {
+      ca = getc(fa);
+      cb = getc(fb);
+    } while((ca == cb) && (ca != EOF));
+    ret = (ca != cb);
+  }
+
+  if(fa) fclose(fa);
+  if(fb) fclose(fb);
+  return ret;
+}
+
+// run the tg68k command on an image
+static void run_tg68k(const char *bin, const char *res) {
+  pid_t pid = fork();
+
+  if(!pid) {
+    int null = open("/dev/null", O_WRONLY);
+    dup2(null, 1);
+    dup2(null, 2);
+    setenv("QUIET", "1", 1);
+    setenv("TG68K_BIN", bin, 1);
+    setenv("RESULT", res, 1);
+    execl("/bin/sh", "sh", "-c", cmd, (char*)NULL);
+    _exit(127);
+  }
+
+  if(pid > 0) waitpid(pid, NULL, 0);
+}
+
+// the worker's file names
+typedef struct {
+  char bin[64], musashi[64], tg68k[64];
+} files_t;
+
+// emit case c, run it on both cores. Returns -1 if musashi doesn't
+// finish, 1 if the results differ and 0 if they match. The ram is only
+// generated again if the data seed changes, otherwise the pages the
+// previous run has written are restored
+static int check(gen_case_t *c, const files_t *f) {
+  static unsigned int data_seed;
+  static int have_data = 0;
+
+  if(!have_data || c->data_seed != data_seed) {
+    gen_emit_data(c);
+    mem_snapshot();
+    data_seed = c->data_seed;
+    have_data = 1;
+  } else
+    mem_restore();
+
+  gen_emit_code(c);
+  if(gen_write(f->bin)) return -1;
+
+  result = fopen(f->musashi, "w");
+  if(!result) { perror(f->musashi); return -1; }
+  int code = gen_run(MAX_CYCLES);
+  fclose(result);
+  result = NULL;
+  if(code < 0) return -1;
+
+  unlink(f->tg68k);
+  run_tg68k(f->bin, f->tg68k);
+  return file_diff(f->musashi, f->tg68k);
+}
+
+// try to simplify a failing case while keeping it failing. Instructions
+// are dropped first, then extension words and registers are cleared
+static void minimize(gen_case_t *c, const files_t *f) {
+  gen_case_t *t = malloc(sizeof(gen_case_t));
+  int changed, i, j;
+
+  do {
+    changed = 0;
+
+    for(i=c->count-1;i>=0 && !stop;i--) {
+      *t = *c;
+      memmove(&t->instr[i], &t->instr[i+1], (t->count-i-1)*sizeof(gen_instr_t));
+      t->count--;
+      if(check(t, f) == 1) { *c = *t; changed = 1; }
+    }
+
+    for(i=0;i<c->count && !stop;i++) {
+      for(j=1;j<c->instr[i].len;j++) {
+	if(!c->instr[i].words[j]) continue;
+
+	*t = *c;
+	t->instr[i].words[j] = 0;
+	gen_instr_len(&t->instr[i]);
+	if(check(t, f) == 1) { *c = *t; changed = 1; }
+      }
+    }
+
+    for(i=0;i<15 && !stop;i++) {
+      if(!c->regs[i]) continue;
+
+      *t = *c;
+      t->regs[i] = (i<8)?0:GEN_DATA;
+      if((c->regs[i] != t->regs[i]) && (check(t, f) == 1)) { *c = *t; changed = 1; }
+    }
+
+    if(c->ccr || c->data_seed) {
+      *t = *c;
+      t->ccr = 0;
+      t->data_seed = 0;
+      if(check(t, f) == 1) { *c = *t; changed = 1; }
+    }
+  } while(changed && !stop);
+
+  free(t);
+}
+
+// keep the failing case as image, listing and both results
+static void save(gen_case_t *c, const files_t *f) {
+  char name[256];
+
+  // leave the files of the minimized case behind
+  check(c, f);
+
+  snprintf(name, sizeof(name), "%s/case_%u.bin", corpus, c->seed);
+  rename(f->bin, name);
+  snprintf(name, sizeof(name), "%s/case_%u.musashi.result", corpus, c->seed);
+  rename(f->musashi, name);
+  snprintf(name, sizeof(name), "%s/case_%u.tg68k.result", corpus, c->seed);
+  rename(f->tg68k, name);
+
+  snprintf(name, sizeof(name), "%s/case_%u.lst", corpus, c->seed);
+  FILE *out = fopen(name, "w");
+  if(out) {
+    gen_list(out, c);
+    fclose(out);
+  }
+
+  if(replay) {
+    snprintf(name, sizeof(name), "./replay.sh %s/case_%u.bin >&2", corpus, c->seed);
+    if(system(name))
+      fprintf(stderr, "replay of case %u failed\n", c->seed);
+  }
+}
+
+static void worker(int id, int jobs, unsigned int seed, int count,
+		   unsigned long cases) {
+  gen_case_t *c = malloc(sizeof(gen_case_t));
+  stats_t *s = &stats[id];
+  files_t f;
+  unsigned long i;
+
+  // keep musashi's complaints about odd addresses off the terminal
+  int null = open("/dev/null", O_WRONLY);
+  dup2(null, 1);
+
+  snprintf(f.bin, sizeof(f.bin), "%s/work%d.bin", corpus, id);
+  snprintf(f.musashi, sizeof(f.musashi), "%s/work%d.musashi.result", corpus, id);
+  snprintf(f.tg68k, sizeof(f.tg68k), "%s/work%d.tg68k.result", corpus, id);
+
+  // workers take interleaved seeds
+  for(i=id;(!cases || i<cases) && !stop;i+=jobs) {
+    gen_random_case(c, seed+i, count);
+
+    int r = check(c, &f);
+    if(r < 0) s->timeouts++;
+    if(r > 0) {
+      fprintf(stderr, "\ncase %u failed, minimizing\n", c->seed);
+      minimize(c, &f);
+      save(c, &f);
+      fprintf(stderr, "case %u reduced to %d instructions\n", c->seed, c->count);
+      s->failures++;
+    }
+    s->cases++;
+  }
+
+  unlink(f.bin);
+  unlink(f.musashi);
+  unlink(f.tg68k);
+  exit(0);
+}
+
+static void report(int jobs, double secs) {
+  stats_t t = { 0, 0, 0 };
+  int i;
+
+  for(i=0;i<jobs;i++) {
+    t.cases += stats[i].cases;
+    t.timeouts += stats[i].timeouts;
+    t.failures += stats[i].failures;
+  }
+
+  fprintf(stderr, "\r%lu cases, %.1f cases/s, %lu timeouts, %lu failures",
+	  t.cases, secs?t.cases/secs:0.0, t.timeouts, t.failures);
+}
+
+int main(int argc, char **argv) {
+  int cpu = M68K_CPU_TYPE_68020, count = 16, jobs = 0;
+  char *mnemonics = NULL;
+  unsigned long cases = 0;
+  int i;
+
+  for(i=1;i<argc-1;i++) {
+    if(!strcmp(argv[i], "-000"))                  cpu = M68K_CPU_TYPE_68000;
+    else if(!strcmp(argv[i], "-j") && i<argc-2)   jobs = atoi(argv[++i]);
+    else if(!strcmp(argv[i], "-n") && i<argc-2)   count = atoi(argv[++i]);
+    else if(!strcmp(argv[i], "-m") && i<argc-2)   mnemonics = argv[++i];
+    else if(!strcmp(argv[i], "-c") && i<argc-2)   cases = strtoul(argv[++i], NULL, 0);
+    else if(!strcmp(argv[i], "-d") && i<argc-2)   corpus = argv[++i];
+    else if(!strcmp(argv[i], "-t") && i<argc-2)   cmd = argv[++i];
+    else if(!strcmp(argv[i], "-w"))               replay = 1;
+    else usage();
+  }
+  if(i != argc-1) usage();
+  unsigned int seed = strtoul(argv[i], NULL, 0);
+
+  if(jobs <= 0) jobs = sysconf(_SC_NPROCESSORS_ONLN);
+  if(jobs <= 0) jobs = 1;
+  if(jobs > MAX_JOBS) jobs = MAX_JOBS;
+
+  if(mkdir(corpus, 0755) && access(corpus, W_OK)) {
+    perror(corpus);
+    return -1;
+  }
+
+  // for the tg68k command and replay.sh
+  setenv("CPU_TYPE", (cpu == M68K_CPU_TYPE_68000)?"68000":"68020", 1);
+
+  // the workers inherit musashi and the generator tables
+  mem_verbose = 0;
+  mem_init(NULL);
+  gen_init(cpu, mnemonics);
+  m68k_init();
+  m68k_set_cpu_type(cpu);
+  m68k_mem_init();
+
+  stats = mmap(NULL, jobs*sizeof(stats_t), PROT_READ|PROT_WRITE,
+	       MAP_SHARED|MAP_ANONYMOUS, -1, 0);
+  if(stats == MAP_FAILED) { perror("mmap"); return -1; }
+  memset(stats, 0, jobs*sizeof(stats_t));
+
+  signal(SIGINT, on_signal);
+  signal(SIGTERM, on_signal);
+
+  fprintf(stderr, "running %d jobs, failing cases go to %s\n", jobs, corpus);
+
+  struct timespec start, now;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  for(i=0;i<jobs;i++)
+    if(!fork())
+      worker(i, jobs, seed, count, cases);
+
+  int running = jobs;
+  double secs = 0;
+  while(running) {
+    // reap finished workers, report once a second
+    while(running && waitpid(-1, NULL, WNOHANG) > 0)
+      running--;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    secs = (now.tv_sec - start.tv_sec) + (now.tv_nsec - start.tv_nsec) / 1e9;
+    report(jobs, secs);
+    if(running) sleep(1);
+  }
+  fprintf(stderr, "\n");
+
+  for(i=0;i<jobs;i++)
+    if(stats[i].failures)
+      return 1;
+
+  return 0;
+}
@@ -0,0 +1,43 @@
+#!/bin/bash
+# re-run a failing case on tg68k with waves. Both cores log their writes,
+# the wave ends a few clocks after the first write that differs
+if [ $# -lt 1 ]; then
+    echo "Please provide a bin file name, e.g. corpus/case_1234.bin"
+    exit
+fi
+
+BIN=$1
+BASE=${BIN%.bin}
+WINDOW=${WINDOW:-200}     # clocks to record after the divergence
+PERIOD=60                 # tg68k_run clock period in ns
+RESET=125                 # reset time in ns
+
+QUIET=1 WRITES=$BASE.musashi.writes RESULT=$BASE.musashi.result ./m68k_run $BIN > /dev/null
+QUIET=1 WRITES=$BASE.tg68k.writes RESULT=$BASE.tg68k.result TG68K_BIN=$BIN \
+    ./tg68k_run --ieee-asserts=disable --stop-time=10ms > /dev/null
+
+# clock of the first tg68k write that differs from musashi or of the
+# last write if tg68k stopped early. Data is compared only in the bytes
+# selected by UDS (ds bit 0, upper byte) and LDS (ds bit 1, lower byte),
+# the other byte lane holds whatever the core left on the bus
+CLOCK=`awk 'function hex(s,   i, v) {
+              v = 0
+              for(i=1;i<=length(s);i++)
+                v = 16*v + index("0123456789abcdef", substr(tolower(s), i, 1)) - 1
+              return v
+            }
+            function write(a, d, ds) {
+              d = hex(d)
+              return a" "((ds%2)?int(d/256):"-")" "((int(ds/2)%2)?d%256:"-")
+            }
+            NR==FNR { m[FNR]=write($2, $3, $4); next }
+            { last=$1 }
+            write($2, $3, $4) != m[FNR] { print $1; found=1; exit }
+            END { if(!found) print last+0 }' $BASE.musashi.writes $BASE.tg68k.writes`
+
+STOP=$(( (CLOCK + WINDOW) * PERIOD + RESET ))
+echo "first divergent write at clock $CLOCK, recording waves up to ${STOP}ns"
+
+QUIET=1 TG68K_BIN=$BIN ./tg68k_run --ieee-asserts=disable \
+    --stop-time=${STOP}ns --wave=$BASE.ghw > /dev/null
+echo "waves written to $BASE.ghw, view with: gtkwave $BASE.ghw tg68k_run.sav"
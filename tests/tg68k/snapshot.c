@@ -0,0 +1,20 @@
+#include <stdlib.h>
+
+#include "mem.h"
+#include "snapshot.h"
+#include "Musashi/m68k.h"
+
+static void *cpu = NULL;
+
+void snapshot_take(void) {
+  if(!cpu) cpu = malloc(m68k_context_size());
+
+  m68k_get_context(cpu);
+  mem_snapshot();
+}
+
+// returns the number of memory pages copied
+int snapshot_restore(void) {
+  m68k_set_context(cpu);
+  return mem_restore();
+}
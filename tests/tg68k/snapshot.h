@@ -0,0 +1,9 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+// snapshot of the Musashi cpu state and the test memory. Restoring
+// only copies the memory pages written since the snapshot was taken
+void snapshot_take(void);
+int snapshot_restore(void);
+
+#endif // SNAPSHOT_H
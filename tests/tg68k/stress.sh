@@ -4,6 +4,10 @@ if [ $# -lt 1 ]; then
     exit
 fi
 
+# tg68k runs without waves, failing cases are replayed with waves
+CASES=0
+START=$SECONDS
+
 while true; do
     ./randomize $1.s $1_rnd.s
     ../../tools/vasm/vasmm68k_mot -m68020 -Fbin -no-opt -o $1.bin -L $1.lst -nosym $1_rnd.s
@@ -11,16 +15,22 @@ while true; do
 	echo "ASM failed"
 	exit
     fi
-    RESULT=$1.tg68k.result TG68K_BIN=$1.bin ./tg68k_run --wave=tg68k_run.ghw --ieee-asserts=disable > /dev/null
-    RESULT=$1.musashi.result ./m68k_run $1.bin > /dev/null
+    QUIET=1 RESULT=$1.tg68k.result TG68K_BIN=$1.bin ./tg68k_run --ieee-asserts=disable > /dev/null
+    QUIET=1 RESULT=$1.musashi.result ./m68k_run $1.bin > /dev/null
     diff $1.tg68k.result $1.musashi.result
     if [ $? -ne 0 ]; then
 	echo "Test failed"
+	./replay.sh $1.bin
 	../../tools/m68kdis/m68kdis -020 $1.bin
 	cat $1.bin.s
 	exit
     fi
 
+    CASES=$((CASES+1))
+    if [ $((SECONDS-START)) -gt 0 ]; then
+	echo -ne "\r$CASES cases, $((CASES*60/(SECONDS-START))) cases/min"
+    fi
+
     if [ $# -eq 2 ]; then
 	echo "Force stop"
 	exit
@@ -0,0 +1,84 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sym.h"
+
+typedef struct {
+  unsigned int addr;
+  char *name;
+} sym_t;
+
+static sym_t *syms = NULL;
+static int nsyms = 0;
+
+static int by_addr(const void *a, const void *b) {
+  unsigned int aa = ((const sym_t*)a)->addr, ab = ((const sym_t*)b)->addr;
+  return (aa > ab) - (aa < ab);
+}
+
+static void sym_add(unsigned int addr, const char *name) {
+  if(!(nsyms & 255))
+    syms = realloc(syms, (nsyms+256) * sizeof(sym_t));
+
+  syms[nsyms].addr = addr;
+  syms[nsyms].name = strdup(name);
+  nsyms++;
+}
+
+// understands the symbol table of vasm listings ("name LAB (0x100) ...")
+// and lines like "00000100 start" or "00000100 T start" (nm)
+int sym_load(const char *name) {
+  char line[256], s[128], t[16];
+  unsigned int addr;
+  int n;
+
+  FILE *f = fopen(name, "r");
+  if(!f) { perror(name); return -1; }
+
+  while(fgets(line, sizeof(line), f)) {
+    if(sscanf(line, "%127s LAB (0x%x)", s, &addr) == 2) {
+      sym_add(addr, s);
+      continue;
+    }
+
+    // plain formats must start with a hex number
+    n = 0;
+    if((sscanf(line, "%x%n", &addr, &n) != 1) || (line[n] != ' ' && line[n] != '\t'))
+      continue;
+
+    if(sscanf(line+n, "%15s %127s", t, s) == 2 && strlen(t) == 1)
+      sym_add(addr, s);
+    else if(sscanf(line+n, "%127s", s) == 1)
+      sym_add(addr, s);
+  }
+  fclose(f);
+
+  qsort(syms, nsyms, sizeof(sym_t), by_addr);
+  return nsyms;
+}
+
+const char *sym_lookup(unsigned int addr, unsigned int *offset) {
+  int lo = 0, hi = nsyms-1, found = -1;
+
+  while(lo <= hi) {
+    int mid = (lo + hi) / 2;
+    if(syms[mid].addr <= addr) { found = mid; lo = mid+1; }
+    else                        hi = mid-1;
+  }
+
+  if(found < 0) return NULL;
+  if(offset) *offset = addr - syms[found].addr;
+  return syms[found].name;
+}
+
+const char *sym_format(unsigned int addr) {
+  static char buf[160];
+  unsigned int offset;
+  const char *name = sym_lookup(addr, &offset);
+
+  if(!name)        snprintf(buf, sizeof(buf), "$%x", addr);
+  else if(!offset) snprintf(buf, sizeof(buf), "%s", name);
+  else             snprintf(buf, sizeof(buf), "%s+$%x", name, offset);
+  return buf;
+}
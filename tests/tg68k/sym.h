@@ -0,0 +1,14 @@
+#ifndef SYM_H
+#define SYM_H
+
+// symbols from a vasm listing (-L) or a plain "address name" file
+int sym_load(const char *name);
+
+// name of the closest symbol at or below addr or NULL. The distance
+// to the symbol is returned in offset
+const char *sym_lookup(unsigned int addr, unsigned int *offset);
+
+// addr as "symbol+offset" or hex number if there is no symbol
+const char *sym_format(unsigned int addr);
+
+#endif // SYM_H
@@ -0,0 +1,27 @@
+	;; Musashi speed benchmark, run with "make bench"
+	;; 64k ram are at $10000
+	dc.l   $10400		; some stack
+	dc.l   start
+
+	org $100
+start:
+	move.l	#99,d7		; 100 * 65536 loops
+outer:	move.w	#$ffff,d6
+inner:	move.l	d6,d0
+	add.l	d7,d0
+	lsl.l	#3,d0
+	eor.w	d6,d0
+	lea	$10000,a0
+	move.l	d0,(a0)+
+	move.w	d0,(a0)
+	add.w	(a0),d1
+	mulu.w	d6,d1
+	bsr	sub
+	dbra	d6,inner
+	dbra	d7,outer
+
+	move.b	#0,$beefed	; exit with result 0
+loop:	bra   	loop
+
+sub:	swap	d1
+	rts
@@ -54,6 +54,7 @@ signal   addr     : std_logic_vector(31 downto 0);
 signal   busstate : std_logic_vector(1 downto 0);
 signal   uds_n    : std_logic;
 signal   lds_n    : std_logic;
+signal   cpu_type : std_logic_vector(1 downto 0) := "11";
 
 begin
 
@@ -68,7 +69,7 @@ begin
       IPL => "111",
       IPL_autovector => '0',
       berr => '0',
-      CPU => "11",  -- 00=68000, 11=68020
+      CPU => cpu_type,  -- 00=68000, 11=68020, set via CPU_TYPE
       addr_out => addr,
       nUDS => uds_n,
       nLDS => lds_n,
@@ -86,6 +87,7 @@ begin
     report "start";
 
     reset_n <= '0';
+    cpu_type <= std_logic_vector(to_unsigned(mem_if_cpu, 2));
     wait for 125 ns; reset_n <= '1';
     
     assert false report "tg68k out of reset"
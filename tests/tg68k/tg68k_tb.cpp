@@ -0,0 +1,102 @@
+// Verilator harness for the TG68K kernel. The Verilog is generated from
+// the VHDL with "ghdl synth". It does the same as tg68k_run.vhd and
+// mem_if_c.c and shares the memory model, so it takes TG68K_BIN, RESULT,
+// QUIET, WRITES, CPU_TYPE and TG68K_CYCLES like the GHDL model
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "Vtg68k.h"
+#include "verilated.h"
+
+extern "C" {
+#include "mem.h"
+}
+
+static Vtg68k* top = NULL;
+
+static unsigned long clocks = 0;
+static FILE *cycles = NULL;
+static struct timespec start;
+
+static void cycles_report(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  double secs = (now.tv_sec - start.tv_sec) + (now.tv_nsec - start.tv_nsec) / 1e9;
+  printf("%lu clocks in %.3f s = %.0f cycles/s\n", clocks, secs, clocks / secs);
+}
+
+// memory access on the falling clock edge like in mem_if_c.c
+static void memory(void) {
+  int busstate = top->busstate;
+  if(busstate == 1) return;
+
+  unsigned int a = top->addr_out;
+  int dstrobe = (top->nuds?0:1) + (top->nlds?0:2);
+
+  if(cycles && (busstate == 0))
+    fprintf(cycles, "%lu %08x\n", clocks, a);
+
+  if(busstate == 3) {
+    mem_clock = clocks;
+    mem_write(a, top->data_write, dstrobe);
+  } else
+    top->data_in = mem_read(a, 3);
+}
+
+// one clock, rising edge first
+static void tick(void) {
+  top->clk = 1;
+  top->eval();
+  top->clk = 0;
+  top->eval();
+  clocks++;
+}
+
+int main(int argc, char **argv) {
+  Verilated::commandArgs(argc, argv);
+
+  if(getenv("TG68K_BIN"))
+    mem_init(getenv("TG68K_BIN"));
+  else {
+    fprintf(stderr, "Please specify a bin file via TG68K_BIN\n");
+    exit(-1);
+  }
+
+  if(getenv("TG68K_CYCLES")) {
+    cycles = fopen(getenv("TG68K_CYCLES"), "w");
+    if(!cycles) perror(getenv("TG68K_CYCLES"));
+  }
+
+  top = new Vtg68k;
+
+  // same wiring as tg68k_run.vhd
+  top->clkena_in = 1;
+  top->ipl = 7;
+  top->ipl_autovector = 0;
+  top->berr = 0;
+  top->cpu = (mem_cpu_type() == 68000)?0:3;   // 00=68000, 11=68020
+  top->data_in = 0;
+
+  // reset for two clocks (125ns in tg68k_run.vhd)
+  top->nreset = 0;
+  top->clk = 0;
+  top->eval();
+  tick();
+  tick();
+  top->nreset = 1;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  atexit(cycles_report);
+
+  // the program ends via mem.c when it writes to the exit address
+  while(!Verilated::gotFinish()) {
+    tick();
+    memory();
+  }
+
+  delete top;
+  return 0;
+}
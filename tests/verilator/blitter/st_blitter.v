@@ -0,0 +1,67 @@
+// st_blitter.v
+//
+// Test wrapper for the blitter of the MiST (../../../cores/mist/blitter.v).
+// The cpu interface uses the signal names of ../common/bus.h and the bus
+// grant follows the bus request one clock later like in mist_top.v.
+//
+
+module st_blitter (
+      input 	    clk,
+      input 	    reset,
+      input [1:0]   bus_cycle,
+      input 	    turbo,
+
+      // cpu register interface
+      input 	    cpu_sel,
+      input [4:0]   cpu_addr,
+      input [15:0]  cpu_din,
+      output [15:0] cpu_dout,
+      input 	    cpu_uds,
+      input 	    cpu_lds,
+      input 	    cpu_rw,
+
+      // ram interface of the bus master
+      output [23:1] ram_addr,
+      output 	    ram_read,
+      output 	    ram_write,
+      output [15:0] ram_dout,
+      input [15:0]  ram_din,
+
+      input 	    br_in,     // bus request of other masters (dma)
+      output 	    br_out,
+      output 	    irq
+);
+
+reg bg;
+
+always @(posedge clk)
+	bg <= br_out;
+
+blitter blitter (
+	.bus_cycle   ( bus_cycle ),
+
+	.clk         ( clk       ),
+	.reset       ( reset     ),
+	.sel         ( cpu_sel   ),
+	.addr        ( cpu_addr  ),
+	.din         ( cpu_din   ),
+	.dout        ( cpu_dout  ),
+	.uds         ( cpu_uds   ),
+	.lds         ( cpu_lds   ),
+	.rw          ( cpu_rw    ),
+
+	.bm_addr     ( ram_addr  ),
+	.bm_write    ( ram_write ),
+	.bm_read     ( ram_read  ),
+	.bm_data_out ( ram_dout  ),
+	.bm_data_in  ( ram_din   ),
+
+	.br_in       ( br_in     ),
+	.br_out      ( br_out    ),
+	.irq         ( irq       ),
+	.bg          ( bg        ),
+
+	.turbo       ( turbo     )
+);
+
+endmodule
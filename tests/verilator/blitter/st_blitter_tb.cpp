@@ -0,0 +1,415 @@
+// st_blitter_tb.cpp
+//
+// Runs random blits through the blitter of the MiST and compares the
+// memory and the address registers with a reference implementation of
+// the blit operations. BENCH=1 instead measures typical blits with and
+// without turbo.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "Vst_blitter.h"
+#include "verilated.h"
+#include "sim.h"
+#include "bus.h"
+
+Vst_blitter* top = NULL;
+
+#define CLK        (8000000.0)
+
+#define MEMSIZE    (128*1024)
+
+#define BLITTER    0xff8a00
+
+st_bus_t<Vst_blitter> bus;
+ram_t ram;
+
+// the cpu bus is driven with the edges of the 8MHz clock
+void clk_edge(int level) {
+  if(level) {
+    top->bus_cycle = (top->bus_cycle + 1)&3;
+    bus.posedge();
+  } else
+    bus.negedge();
+}
+
+// bus statistics, counted while the blitter is busy
+unsigned long stat_clocks, stat_reads, stat_writes;
+
+// memory is accessed on the falling edge
+int clk_mem(int level) {
+  if(level) return 0;
+
+  if(top->irq) stat_clocks++;
+
+  if(top->ram_read) {
+    top->ram_din = ram.read16(top->ram_addr<<1);
+    stat_reads++;
+  }
+
+  if(top->ram_write) {
+    ram.write16(top->ram_addr<<1, top->ram_dout);
+    stat_writes++;
+  }
+
+  return top->ram_read;
+}
+
+// ---------------------------- reference blitter -------------------------------
+
+typedef struct {
+  uint16_t halftone[16];
+  int16_t src_x_inc, src_y_inc, dst_x_inc, dst_y_inc;
+  uint32_t src_addr, dst_addr;
+  uint16_t endmask1, endmask2, endmask3;
+  uint16_t x_count, y_count;
+  int hop, op, line, smudge, hog, skew, nfsr, fxsr;
+} blit_t;
+
+// the source buffer, like in the blitter it's kept between blits. The
+// model starts with zero, the verilator default
+uint32_t ref_src = 0;
+
+static int no_src_op(int op) { return op == 0 || op == 5 || op == 10 || op == 15; }
+
+static uint16_t blitter_op(int op, uint16_t s, uint16_t d) {
+  switch(op) {
+  case 0:  return 0;
+  case 1:  return  s &  d;
+  case 2:  return  s & ~d;
+  case 3:  return  s;
+  case 4:  return ~s &  d;
+  case 5:  return       d;
+  case 6:  return  s ^  d;
+  case 7:  return  s |  d;
+  case 8:  return ~s & ~d;
+  case 9:  return ~s ^  d;
+  case 10: return      ~d;
+  case 11: return  s | ~d;
+  case 12: return ~s;
+  case 13: return ~s |  d;
+  case 14: return ~s | ~d;
+  }
+  return 0xffff;
+}
+
+// read the next source word into the buffer
+static int ref_src_read(blit_t *b, ram_t *m, uint32_t *src) {
+  unsigned char *p = m->ptr(b->src_addr & 0xfffffe, 2);
+  if(!p) return -1;
+  uint16_t w = 256*p[0] + p[1];
+  if(b->src_x_inc >= 0) *src = (*src << 16) | w;
+  else                  *src = (*src >> 16) | (w << 16);
+  return 0;
+}
+
+// blit with the registers in b, returns -1 for an access outside of m.
+// The addresses and counters in b end up like in the blitter
+int blit_ref(blit_t *b, ram_t *m, uint32_t *src) {
+  int skip_src = (b->hop < 2 || no_src_op(b->op)) && !b->smudge;
+  int line = b->line;
+
+  while(b->y_count) {
+    if(!skip_src && b->fxsr) {
+      if(ref_src_read(b, m, src)) return -1;
+      b->src_addr += b->src_x_inc;
+    }
+
+    for(uint16_t x = b->x_count;;x--) {
+      int first = (x == b->x_count), last = (x == 1);
+
+      if(!skip_src) {
+	if(b->nfsr && last) {
+	  // no final source read, but shifting anyway
+	  if(b->src_x_inc >= 0) *src = (*src & 0xffff) | (*src << 16);
+	  else                  *src = (*src & 0xffff0000) | (*src >> 16);
+	  b->src_addr += b->src_y_inc - b->src_x_inc;
+	} else {
+	  if(ref_src_read(b, m, src)) return -1;
+	  b->src_addr += last?b->src_y_inc:b->src_x_inc;
+	}
+      }
+
+      uint16_t skewed = *src >> b->skew;
+      uint16_t halftone = b->halftone[b->smudge?(skewed & 15):line];
+      uint16_t s = (b->hop == 0)?0xffff:(b->hop == 1)?halftone:
+	(b->hop == 2)?skewed:(halftone & skewed);
+
+      unsigned char *p = m->ptr(b->dst_addr & 0xfffffe, 2);
+      if(!p) return -1;
+      uint16_t d = 256*p[0] + p[1];
+      uint16_t mask = first?b->endmask1:last?b->endmask3:b->endmask2;
+      uint16_t r = (blitter_op(b->op, s, d) & mask) | (d & ~mask);
+      p[0] = r >> 8;
+      p[1] = r;
+
+      if(!last)
+	b->dst_addr += b->dst_x_inc;
+      else {
+	b->dst_addr += b->dst_y_inc;
+	line = (line + ((b->dst_y_inc >= 0)?1:-1)) & 15;
+	break;
+      }
+    }
+    b->y_count--;
+  }
+  b->src_addr &= 0xfffffe;
+  b->dst_addr &= 0xfffffe;
+  return 0;
+}
+
+// --------------------------------- blitter ------------------------------------
+
+void blit_start(blit_t *b) {
+  int i;
+
+  for(i=0;i<16;i++)
+    bus.write(BLITTER + 2*i, b->halftone[i]);
+
+  bus.write(BLITTER + 0x20, b->src_x_inc);
+  bus.write(BLITTER + 0x22, b->src_y_inc);
+  bus.write(BLITTER + 0x24, b->src_addr >> 16);
+  bus.write(BLITTER + 0x26, b->src_addr);
+  bus.write(BLITTER + 0x28, b->endmask1);
+  bus.write(BLITTER + 0x2a, b->endmask2);
+  bus.write(BLITTER + 0x2c, b->endmask3);
+  bus.write(BLITTER + 0x2e, b->dst_x_inc);
+  bus.write(BLITTER + 0x30, b->dst_y_inc);
+  bus.write(BLITTER + 0x32, b->dst_addr >> 16);
+  bus.write(BLITTER + 0x34, b->dst_addr);
+  bus.write(BLITTER + 0x36, b->x_count);
+  bus.write(BLITTER + 0x38, b->y_count);
+  bus.write(BLITTER + 0x3a, (b->hop << 8) | b->op);
+
+  // busy, hog, smudge and line number in the upper, fxsr, nfsr and skew
+  // in the lower byte
+  bus.write(BLITTER + 0x3c, 0x8000 | (b->hog << 14) | (b->smudge << 13) |
+	    (b->line << 8) | (b->fxsr << 7) | (b->nfsr << 6) | b->skew);
+}
+
+// wait until the blitter is done, 0 on timeout
+int blit_wait(double timeout_us) {
+  sim_time_t end = sim_time + SIM_US(timeout_us);
+
+  sim_wait_us(1);
+  while(top->irq && sim_time < end)
+    sim_wait_us(1);
+  return !top->irq;
+}
+
+void blit_print(const blit_t *b) {
+  printf("  src %06x inc %d/%d, dst %06x inc %d/%d, count %d x %d\n",
+	 b->src_addr, b->src_x_inc, b->src_y_inc,
+	 b->dst_addr, b->dst_x_inc, b->dst_y_inc, b->x_count, b->y_count);
+  printf("  hop %d op %d line %d smudge %d skew %d nfsr %d fxsr %d hog %d, masks %04x %04x %04x\n",
+	 b->hop, b->op, b->line, b->smudge, b->skew, b->nfsr, b->fxsr, b->hog,
+	 b->endmask1, b->endmask2, b->endmask3);
+}
+
+// blit on the model and the reference and compare, 0 if ok
+int blit_check(blit_t *b) {
+  blit_t r = *b;
+
+  // the reference works on a copy taken before the blit
+  static ram_t ref;
+  if(!ref.mem) ref.init(ram.base, ram.size);
+  memcpy(ref.mem, ram.mem, ram.size);
+
+  blit_start(b);
+  if(!blit_wait(100000)) {
+    printf("ERROR: blitter still busy\n");
+    blit_print(b);
+    return -1;
+  }
+
+  if(blit_ref(&r, &ref, &ref_src)) return -1;
+
+  int errors = 0;
+  for(uint32_t a=0;a<ram.size;a+=2) {
+    uint16_t is = ram.read16(ram.base + a), exp = ref.read16(ram.base + a);
+    if(is != exp && errors++ < 5)
+      printf("ERROR: $%06x is %04x, expected %04x\n", ram.base + a, is, exp);
+  }
+
+  uint32_t src = (bus.read(BLITTER + 0x24) & 0xff) << 16 | bus.read(BLITTER + 0x26);
+  uint32_t dst = (bus.read(BLITTER + 0x32) & 0xff) << 16 | bus.read(BLITTER + 0x34);
+  if(src != r.src_addr || dst != r.dst_addr) {
+    printf("ERROR: addresses %06x/%06x, expected %06x/%06x\n",
+	   src, dst, r.src_addr, r.dst_addr);
+    errors++;
+  }
+
+  if(errors) blit_print(b);
+  return errors?-1:0;
+}
+
+int rnd(int n) { return random() % n; }
+
+int16_t rnd_inc(void) {
+  static const int16_t inc[] = { 2, 2, 8, -2, -8 };
+  return inc[rnd(5)];
+}
+
+uint16_t rnd_mask(void) {
+  return rnd(2)?0xffff:random();
+}
+
+// random blit that stays within ram
+void blit_random(blit_t *b) {
+  static ram_t scratch;
+  int i;
+
+  if(!scratch.mem) scratch.init(ram.base, ram.size);
+
+  do {
+    for(i=0;i<16;i++) b->halftone[i] = random();
+    b->x_count = 1 + (rnd(4)?rnd(8):rnd(64));
+    b->y_count = 1 + rnd(16);
+    b->src_x_inc = rnd_inc();
+    b->dst_x_inc = rnd_inc();
+    b->src_y_inc = 2*(rnd(401) - 200);
+    b->dst_y_inc = 2*(rnd(401) - 200);
+    b->src_addr = ram.base + 2*rnd(ram.size/2);
+    b->dst_addr = ram.base + 2*rnd(ram.size/2);
+    b->endmask1 = rnd_mask();
+    b->endmask2 = rnd_mask();
+    b->endmask3 = rnd_mask();
+    b->hop = rnd(4);
+    b->op = rnd(16);
+    b->line = rnd(16);
+    b->smudge = !rnd(8);
+    b->hog = rnd(2);
+    b->skew = rnd(16);
+    b->nfsr = rnd(2);
+    b->fxsr = rnd(2);
+
+    // try the blit on scratch memory first
+    blit_t t = *b;
+    uint32_t src = ref_src;
+    if(!blit_ref(&t, &scratch, &src)) break;
+  } while(1);
+}
+
+// -------------------------------- benchmark -----------------------------------
+
+typedef struct {
+  const char *name;
+  int hop, op, skew, fxsr, masked;
+} bench_t;
+
+const bench_t benches[] = {
+  { "fill",   0, 15, 0, 0, 0 },   // no source, no destination read
+  { "copy",   2,  3, 0, 0, 0 },   // source read only
+  { "shift",  2,  3, 5, 1, 1 },   // skewed with masks, reads the destination
+  { "xor",    2,  6, 0, 0, 0 },   // source and destination read
+  { NULL }
+};
+
+// a 320x200 low resolution screen, 4 planes of 20 words per line
+void bench_run(const bench_t *t, int turbo, int hog) {
+  blit_t b;
+  memset(&b, 0, sizeof(b));
+  memset(b.halftone, 0xff, sizeof(b.halftone));
+
+  b.src_x_inc = 2;
+  b.dst_x_inc = 2;
+  b.x_count = 80;
+  b.y_count = 200;
+  b.src_addr = ram.base;
+  b.dst_addr = ram.base + 32000;
+  b.src_y_inc = 2 - 2*t->fxsr;
+  b.dst_y_inc = 2;
+  b.endmask1 = t->masked?0x07ff:0xffff;
+  b.endmask2 = 0xffff;
+  b.endmask3 = t->masked?0xf800:0xffff;
+  b.hop = t->hop;
+  b.op = t->op;
+  b.skew = t->skew;
+  b.fxsr = t->fxsr;
+  b.hog = hog;
+
+  top->turbo = turbo;
+  stat_clocks = stat_reads = stat_writes = 0;
+
+  if(blit_check(&b)) { trace_fail(); exit(1); }
+
+  // the blitter owns the cpu bus slots of a 2MHz bus cycle, the second
+  // one only with turbo
+  double cycles = stat_clocks/4.0;
+  unsigned long words = (unsigned long)b.x_count * b.y_count;
+  printf("%-6s %5s %3s %8.1f %8.3f %8.1f%% %9.0f\n", t->name,
+	 turbo?"turbo":"-", hog?"hog":"-", stat_clocks/8.0,
+	 words/cycles, 100.0*(stat_reads + stat_writes)/(cycles*(turbo?2:1)),
+	 2*words/(stat_clocks/CLK)/1024);
+}
+
+void bench(void) {
+  const bench_t *t;
+
+  printf("%-6s %5s %3s %8s %8s %9s %9s\n", "blit", "turbo", "hog",
+	 "us", "words/bc", "occupancy", "kB/s");
+
+  for(t=benches;t->name;t++)
+    for(int turbo=0;turbo<2;turbo++)
+      for(int hog=1;hog>=0;hog--)
+	bench_run(t, turbo, hog);
+}
+
+int main(int argc, char **argv, char **env) {
+  Verilated::commandArgs(argc, argv);
+  // init top verilog instance
+  top = new Vst_blitter;
+  sim_init(top);
+
+  unsigned int seed = getenv("SEED")?atoi(getenv("SEED")):time(NULL);
+  srandom(seed);
+
+  // init trace dump, see trace.h
+  trace_init(top, "st_blitter");
+
+  ram.init(0, MEMSIZE);
+  for(uint32_t a=0;a<MEMSIZE;a+=2)
+    ram.write16(a, random());
+
+  // initialize system inputs
+  top->clk = 1;
+  top->reset = 1;
+  top->turbo = 0;
+  top->br_in = 0;
+  top->cpu_sel = 0;
+  bus.init(top, BLITTER, ~0x3f);
+
+  sim_add_clock(&top->clk, CLK, clk_edge, clk_mem);
+
+  sim_wait_us(1);
+  top->reset = 0;
+  sim_wait_us(1);
+
+  if(getenv("BENCH")) {
+    bench();
+    sim_report();
+    trace_close();
+    return 0;
+  }
+
+  int blits = getenv("BLITS")?atoi(getenv("BLITS")):1000;
+  printf("%d random blits, SEED=%u\n", blits, seed);
+
+  for(int i=0;i<blits;i++) {
+    blit_t b;
+    blit_random(&b);
+    top->turbo = rnd(2);
+    if(blit_check(&b)) {
+      printf("blit %d failed\n", i);
+      trace_fail();
+      exit(1);
+    }
+  }
+  printf("all blits ok\n");
+
+  sim_report();
+  trace_close();
+  return 0;
+}
@@ -0,0 +1,77 @@
+// caches.v
+//
+// Test wrapper for the cpu caches of the MiST (../../../cores/mist/cache.v).
+// Instruction and data cache are connected like in mist_top.v: both see
+// the cpu address, the instruction cache stores lines on opcode fetches,
+// the data cache on data reads and both are updated on cpu writes.
+//
+
+module caches #(parameter BITS = 8) (
+      input 	    clk_128,
+      input 	    clk_32,
+      input 	    reset,
+      input 	    flush,
+
+      input [23:1]  addr,   // cpu address
+      input [1:0]   ds,     // upper (0) and lower (1) data strobe, active high
+
+      output [15:0] dout,
+      output        hit,
+      output        inst_hit,
+      output        data_hit,
+
+      input [63:0]  din64,
+      input         istore,
+      input         dstore,
+
+      input [15:0]  din16,
+      input         update
+);
+
+// same as in mist_top.v
+wire cacheable = ((addr[23:22] == 2'b00) ||       // ordinary 4MB
+		  (addr[23:22] == 2'b01) ||       // 8MB
+		  (addr[23:22] == 2'b10) ||       // 12MB
+		  (addr[23:21] == 3'b110) ||      // 14MB
+		  (addr[23:18] == 6'b111000) ||   // 256k TOS
+		  (addr[23:17] == 7'b1111110) ||  // first 128k of 192k TOS
+		  (addr[23:16] == 8'b11111110) ); // second 64k of 192k TOS
+
+wire [15:0] data_dout, inst_dout;
+
+assign hit = cacheable && (data_hit || inst_hit);
+assign dout = data_hit?data_dout:inst_dout;
+
+cache #(.BITS(BITS)) data_cache (
+	.clk_128  ( clk_128   ),
+	.clk      ( clk_32    ),
+	.reset    ( reset     ),
+	.flush    ( flush     ),
+	.strobe   ( 1'b0      ),
+	.addr     ( addr      ),
+	.ds       ( ds        ),
+	.hit      ( data_hit  ),
+	.dout     ( data_dout ),
+	.store    ( dstore    ),
+	.din64    ( din64     ),
+	.update   ( update    ),
+	.din16    ( din16     )
+);
+
+cache #(.BITS(BITS)) instruction_cache (
+	.clk_128  ( clk_128   ),
+	.clk      ( clk_32    ),
+	.reset    ( reset     ),
+	.flush    ( flush     ),
+	.strobe   ( 1'b0      ),
+	.addr     ( addr      ),
+	.ds       ( ds        ),
+	.hit      ( inst_hit  ),
+	.dout     ( inst_dout ),
+	.store    ( istore    ),
+	.din64    ( din64     ),
+	.update   ( update    ),
+	.din16    ( din16     )
+);
+
+endmodule
@@ -0,0 +1,276 @@
+// caches_tb.cpp
+//
+// Replays cpu bus accesses through the instruction and data cache of
+// the MiST and checks every hit against a reference memory and a
+// reference model of the cache tags. Synthetic access mixes always run,
+// bus traces of m68k_run (BUSTRACE=file, see ../../tg68k/readme.md)
+// are given as arguments.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Vcaches.h"
+#include "verilated.h"
+#include "sim.h"
+
+#ifndef BITS
+#define BITS 8
+#endif
+#define ENTRIES (1<<BITS)
+
+#define CLK        (32000000.0)
+#define PERIOD     SIM_NS(1000000000.0/CLK)
+
+Vcaches* top = NULL;
+
+// the 16MB address space word by word
+uint16_t *ref;
+
+// tags of the reference model, ~0 is an invalid line
+uint32_t itag[ENTRIES], dtag[ENTRIES];
+
+typedef struct {
+  char type;          // F(etch), R(ead) or W(rite)
+  uint32_t addr;      // byte address
+  int ds;             // 1 upper, 2 lower, 3 both bytes
+  uint16_t data;
+} access_t;
+
+typedef struct {
+  unsigned long fetches, fetch_hits;
+  unsigned long reads, read_hits;
+  unsigned long writes, write_hits;
+  unsigned long uncached, errors;
+} stats_t;
+
+// same as in mist_top.v
+int cacheable(uint32_t a) {
+  return ((a >> 22) != 3) || ((a >> 21) == 6) || ((a >> 18) == 0x38) ||
+    ((a >> 17) == 0x7e) || ((a >> 16) == 0xfe);
+}
+
+void flush(void) {
+  top->flush = 1;
+  sim_wait_ps(PERIOD);
+  top->flush = 0;
+  memset(itag, 0xff, sizeof(itag));
+  memset(dtag, 0xff, sizeof(dtag));
+}
+
+void error(stats_t *s, const access_t *a, const char *msg) {
+  if(s->errors++ < 10)
+    printf("ERROR: %c %06x ds %d: %s\n", a->type, a->addr, a->ds, msg);
+  if(s->errors == 1) trace_fail();
+}
+
+// one cpu access, the address is presented for one 32MHz cycle
+void access(stats_t *s, const access_t *a) {
+  uint32_t word = (a->addr & 0xffffff) >> 1;
+  uint32_t line = word >> 2 & (ENTRIES-1);
+  uint32_t tag = word >> (2+BITS);
+
+  if(!cacheable(a->addr)) {
+    s->uncached++;
+    return;
+  }
+
+  top->addr = word;
+  top->ds = a->ds;
+  sim_wait_ps(PERIOD);
+
+  int hit = (itag[line] == tag) || (dtag[line] == tag);
+  if(top->hit != hit)
+    error(s, a, hit?"missing hit":"unexpected hit");
+
+  if(a->type == 'W') {
+    s->writes++;
+    s->write_hits += hit;
+
+    if(a->ds & 1) ref[word] = (ref[word] & 0x00ff) | (a->data & 0xff00);
+    if(a->ds & 2) ref[word] = (ref[word] & 0xff00) | (a->data & 0x00ff);
+
+    // write through, a hit updates the line
+    top->din16 = a->data;
+    top->update = 1;
+    sim_wait_ps(PERIOD);
+    top->update = 0;
+    return;
+  }
+
+  if(a->type == 'F') { s->fetches++; s->fetch_hits += hit; }
+  else               { s->reads++;   s->read_hits += hit;  }
+
+  if(hit) {
+    if(top->dout != ref[word]) {
+      char msg[64];
+      sprintf(msg, "read %04x, expected %04x", top->dout, ref[word]);
+      error(s, a, msg);
+    }
+    return;
+  }
+
+  // miss, the line is read from ram and stored
+  uint64_t din = 0;
+  for(int i=0;i<4;i++)
+    din |= (uint64_t)ref[(word & ~3) + i] << (16*i);
+  top->din64 = din;
+  if(a->type == 'F') { top->istore = 1; itag[line] = tag; }
+  else               { top->dstore = 1; dtag[line] = tag; }
+  sim_wait_ps(PERIOD);
+  top->istore = top->dstore = 0;
+}
+
+// ------------------------------ access mixes ----------------------------------
+
+// generators return 0 when the mix ends
+typedef int (*mix_t)(unsigned long n, access_t *a);
+
+// accesses per synthetic mix and replayed per trace (0: all)
+unsigned long accesses = 200000, limit = 0;
+
+int rnd(int n) { return random() % n; }
+
+int rnd_ds(void) { return rnd(4)?3:(1+rnd(2)); }
+
+// a tight loop of 1k
+int mix_loop1k(unsigned long n, access_t *a) {
+  a->type = 'F';
+  a->addr = 0x10000 + (2*n & 1023);
+  a->ds = 3;
+  return n < accesses;
+}
+
+// code in 16k with a branch every 8 accesses on average, reads and
+// writes to 4k of data
+int mix_code16k(unsigned long n, access_t *a) {
+  static uint32_t pc;
+  int r = rnd(10);
+
+  if(!n || !rnd(8)) pc = 0x20000 + 2*rnd(8192);
+
+  if(r < 7) {
+    a->type = 'F';
+    a->addr = pc;
+    a->ds = 3;
+    pc = (pc + 2 - 0x20000) % 16384 + 0x20000;
+  } else {
+    a->type = (r < 9)?'R':'W';
+    a->addr = 0x30000 + 2*rnd(2048);
+    a->ds = rnd_ds();
+    a->data = random();
+  }
+  return n < accesses;
+}
+
+// random reads and writes in 64k
+int mix_random64k(unsigned long n, access_t *a) {
+  a->type = rnd(4)?'R':'W';
+  a->addr = 0x40000 + 2*rnd(32768);
+  a->ds = rnd_ds();
+  a->data = random();
+  return n < accesses;
+}
+
+// memcpy of 1MB with a short copy loop
+int mix_stream(unsigned long n, access_t *a) {
+  static const char type[] = "FFRW";
+  a->type = type[n & 3];
+  a->ds = 3;
+  a->data = random();
+  if(a->type == 'F')      a->addr = 0x60000 + (2*n & 7);
+  else if(a->type == 'R') a->addr = 0x100000 + (n/4*2 & 0xfffff);
+  else                    a->addr = 0x200000 + (n/4*2 & 0xfffff);
+  return n < accesses;
+}
+
+// bus trace of m68k_run
+FILE *trace;
+
+int mix_trace(unsigned long n, access_t *a) {
+  char line[64];
+  unsigned int addr, data = 0;
+
+  if(limit && n >= limit) return 0;
+
+  while(fgets(line, sizeof(line), trace)) {
+    if(sscanf(line, "%c %x %d %x", &a->type, &addr, &a->ds, &data) < 3)
+      continue;
+    a->addr = addr;
+    a->data = data;
+    return 1;
+  }
+  return 0;
+}
+
+void run(const char *name, mix_t mix) {
+  stats_t s;
+  access_t a;
+  unsigned long n;
+
+  memset(&s, 0, sizeof(s));
+  flush();
+
+  for(n=0;mix(n, &a);n++)
+    access(&s, &a);
+
+  printf("%-16s %9lu  %5.1f%%  %5.1f%%  %5.1f%%  %9lu  %lu\n", name, n,
+	 s.fetches?100.0*s.fetch_hits/s.fetches:0.0,
+	 s.reads?100.0*s.read_hits/s.reads:0.0,
+	 s.writes?100.0*s.write_hits/s.writes:0.0,
+	 s.uncached, s.errors);
+  fflush(stdout);
+
+  if(s.errors) exit(1);
+}
+
+int main(int argc, char **argv, char **env) {
+  Verilated::commandArgs(argc, argv);
+  // init top verilog instance
+  top = new Vcaches;
+  sim_init(top);
+
+  // init trace dump, see trace.h
+  trace_init(top, "caches");
+
+  if(getenv("ACCESSES")) accesses = strtoul(getenv("ACCESSES"), NULL, 0);
+  if(getenv("LIMIT"))    limit = strtoul(getenv("LIMIT"), NULL, 0);
+
+  // the reference memory is random, the same for every run
+  srandom(1);
+  ref = (uint16_t*)malloc(2*8*1024*1024);
+  for(int i=0;i<8*1024*1024;i++)
+    ref[i] = random();
+
+  top->clk_32 = 1;
+  top->clk_128 = 1;
+  top->reset = 1;
+  sim_add_clock(&top->clk_32, CLK);
+  sim_add_clock(&top->clk_128, 4*CLK);
+  sim_wait_ps(2*PERIOD);
+  top->reset = 0;
+
+  printf("BITS=%d: 2 caches of %d bytes\n", BITS, 8*ENTRIES);
+  printf("%-16s %9s  %6s  %6s  %6s  %9s  %s\n", "mix", "accesses",
+	 "fetch", "read", "write", "uncached", "errors");
+
+  run("loop1k", mix_loop1k);
+  run("code16k", mix_code16k);
+  run("random64k", mix_random64k);
+  run("stream", mix_stream);
+
+  for(int i=1;i<argc;i++) {
+    if(argv[i][0] == '+') continue;
+    if(!(trace = fopen(argv[i], "r"))) {
+      perror(argv[i]);
+      continue;
+    }
+    const char *name = strrchr(argv[i], '/');
+    run(name?name+1:argv[i], mix_trace);
+    fclose(trace);
+  }
+
+  sim_report();
+  trace_close();
+  return 0;
+}
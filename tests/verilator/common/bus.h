@@ -0,0 +1,171 @@
+// bus.h
+//
+// Bus models for the verilator testbenches: ST memory, the 68000 side
+// of the ST bus and the SPI master of the io controller. They use the
+// scheduler in sim.h and are bound to the model ports by template or
+// by pointer, so they work with any core that has these signals.
+
+#ifndef BUS_H
+#define BUS_H
+
+#include <stdio.h>
+#include <string.h>
+
+#include "sim.h"
+
+// memory in 68k (big endian) byte order
+typedef struct ram_s {
+  unsigned char *mem;
+  uint32_t base, size;
+
+  void init(uint32_t b, uint32_t s) {
+    base = b;
+    size = s;
+    mem = new unsigned char[s];
+    memset(mem, 0, s);
+  }
+
+  unsigned char *ptr(uint32_t addr, uint32_t len) {
+    if(addr < base || addr+len > base+size) return NULL;
+    return mem + addr - base;
+  }
+
+  uint16_t read16(uint32_t addr) {
+    unsigned char *p = ptr(addr, 2);
+    if(!p) { printf("Reading outside range: %x\n", addr); return 0; }
+    return 256*p[0] + p[1];
+  }
+
+  void write16(uint32_t addr, uint16_t data) {
+    unsigned char *p = ptr(addr, 2);
+    if(!p) { printf("Writing outside range: %x\n", addr); return; }
+    p[0] = data >> 8;
+    p[1] = data;
+  }
+
+  // four words as used by the video, first word in bits 15:0
+  uint64_t read64(uint32_t addr) {
+    unsigned char *p = ptr(addr, 8);
+    uint64_t v = 0;
+    int i;
+    if(!p) { printf("Reading outside range: %x\n", addr); return 0; }
+    for(i=3;i>=0;i--)
+      v = (v << 16) | (256*p[2*i] + p[2*i+1]);
+    return v;
+  }
+} ram_t;
+
+// the cpu side of the ST bus. The cpu owns bus cycle 0 of the four
+// 8MHz cycles of a 2MHz bus cycle. read() and write() post an access
+// to a register window (e.g. base 0xff8600, mask ~0xf) and wait for it.
+// The testbench calls posedge() and negedge() from its 8MHz cpu clock.
+// ds selects the data strobes of the posted access (2=upper, 1=lower)
+template<class T> struct st_bus_t {
+  T *top;
+  uint32_t base, mask;
+  uint32_t rd_addr, wr_addr;
+  uint16_t rd_data, wr_data;
+  int ds;
+  unsigned long reads, writes;
+
+  void init(T *t, uint32_t b, uint32_t m) {
+    top = t;
+    base = b;
+    mask = m;
+    rd_addr = wr_addr = 0;
+    ds = 3;
+    reads = writes = 0;
+  }
+
+  void select(uint32_t addr) {
+    top->cpu_sel = (addr & mask) == base;
+    top->cpu_addr = (addr & ~mask)>>1;
+    top->cpu_uds = !(ds & 2);
+    top->cpu_lds = !(ds & 1);
+  }
+
+  // rising cpu clock: drive the posted access in bus cycle 0
+  void posedge(void) {
+    top->cpu_sel = 0;
+    if(top->bus_cycle != 0) return;
+
+    if(rd_addr) {
+      select(rd_addr);
+      top->cpu_rw = 1;
+    }
+
+    if(wr_addr) {
+      select(wr_addr);
+      top->cpu_rw = 0;
+      top->cpu_din = wr_data;
+      wr_addr = 0;
+      writes++;
+    }
+  }
+
+  // falling cpu clock: the cpu latches read data
+  void negedge(void) {
+    if(top->bus_cycle == 0 && top->cpu_sel && top->cpu_rw && rd_addr) {
+      rd_data = top->cpu_dout;
+      rd_addr = 0;
+      reads++;
+    }
+  }
+
+  // both wait two 2MHz bus cycles
+  uint16_t read(uint32_t addr) {
+    ds = 3;
+    rd_addr = addr;
+    sim_wait_us(1);
+    return rd_data;
+  }
+
+  void write(uint32_t addr, uint16_t data) {
+    ds = 3;
+    wr_addr = addr;
+    wr_data = data;
+    sim_wait_us(1);
+  }
+};
+
+// SPI master, msb first. Data is set after the falling and sampled
+// at the rising sck edge (mode 0 with idle_high = 0, mode 3 with 1)
+typedef struct spi_master_s {
+  CData *sck, *mosi, *miso;
+  double quarter_ns;
+  int idle_high;
+  unsigned long bytes;
+
+  void init(CData *clk, CData *out, CData *in, double hz, int idle) {
+    sck = clk;
+    mosi = out;
+    miso = in;
+    quarter_ns = 1000000000.0/hz/4;
+    idle_high = idle;
+    bytes = 0;
+    *sck = idle_high;
+  }
+
+  unsigned char transfer(unsigned char byte) {
+    unsigned char retval = 0;
+    int bit;
+
+    for(bit=0;bit<8;bit++) {
+      if(idle_high) *sck = 0;
+      sim_wait_ns(quarter_ns);
+      *mosi = (byte & (0x80>>bit))?1:0;
+      sim_wait_ns(quarter_ns);
+      // miso as the slave drives it right at the rising edge
+      retval = (retval << 1) | (*miso?1:0);
+      *sck = 1;
+      sim_wait_ns(quarter_ns);
+      if(!idle_high) *sck = 0;
+      sim_wait_ns(quarter_ns);
+    }
+
+    bytes++;
+    return retval;
+  }
+} spi_master_t;
+
+#endif // BUS_H
@@ -0,0 +1,239 @@
+// cpu68k.h
+//
+// Musashi 68000 as the cpu of a testbench. The cpu runs real 68k code
+// from a binary (vasm -Fbin) as a coroutine of the 8MHz cpu clock. A
+// binary loaded to address 0 has its own reset vectors, elsewhere the
+// cpu starts at the begin of the binary with the stack at the end of
+// its ram. Accesses to the register window of the st_bus_t
+// go through the model, everything else hits the mapped ram_t regions
+// directly.
+//
+// Timing: each instruction takes the cycles Musashi reports. An access
+// to the model waits for the cpu's bus slot (bus cycle 0) and then takes
+// the 4 clocks of a 68000 bus cycle. The clocks spent waiting for the
+// slot are counted as stall cycles. Memory accesses outside the window
+// are not aligned to the bus slots.
+//
+// The testbench calls cpu_clock() on each rising cpu clock edge before
+// st_bus_t::posedge(). The program ends with a STOP instruction.
+// Needs the model built with MUSASHI, see the Makefile.
+
+#ifndef CPU68K_H
+#define CPU68K_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <ucontext.h>
+
+#include "bus.h"
+
+extern "C" {
+#include "Musashi/m68k.h"
+}
+
+#define CPU_MAX_RAM   4
+#define CPU_STACK     (256*1024)
+
+static ram_t *cpu_maps[CPU_MAX_RAM];
+static int cpu_nmaps = 0;
+static ram_t cpu_vectors;
+
+static int cpu_running = 0, cpu_stopped = 0;
+static ucontext_t cpu_main_ctx, cpu_ctx;
+static unsigned long long cpu_clocks = 0, cpu_resume = 0;
+static int cpu_io = 0, cpu_insn_io = 0;    // cpu_io: 1 posted, 2 driven
+
+// statistics
+static unsigned long long cpu_instructions = 0, cpu_cycles = 0;
+static unsigned long long cpu_io_accesses = 0, cpu_stalls = 0;
+
+// the bus model, bound by cpu_init()
+static void *cpu_bus = NULL;
+static int (*cpu_bus_match)(uint32_t addr) = NULL;
+static void (*cpu_bus_post)(uint32_t addr, int rw, int ds, uint16_t data) = NULL;
+static int (*cpu_bus_slot)(void) = NULL;
+static uint16_t (*cpu_bus_data)(void) = NULL;
+
+// give control back to the simulation until cpu_clock() resumes
+static void cpu_yield(unsigned long long clocks) {
+  cpu_resume = cpu_clocks + clocks;
+  swapcontext(&cpu_ctx, &cpu_main_ctx);
+}
+
+static uint16_t cpu_bus_access(uint32_t addr, int rw, int ds, uint16_t data) {
+  unsigned long long start = cpu_clocks;
+
+  cpu_bus_post(addr, rw, ds, data);
+  cpu_io = 1;
+  cpu_yield(~0ull >> 1);
+
+  cpu_io_accesses++;
+  cpu_insn_io++;
+  cpu_stalls += cpu_clocks - start - 4;
+  return cpu_bus_data();
+}
+
+static unsigned char *cpu_ptr(uint32_t addr, uint32_t len) {
+  int i;
+  for(i=0;i<cpu_nmaps;i++) {
+    unsigned char *p = cpu_maps[i]->ptr(addr, len);
+    if(p) return p;
+  }
+  return NULL;
+}
+
+extern "C" {
+
+unsigned int m68k_read_memory_8(unsigned int address) {
+  address &= 0xffffff;
+  if(cpu_bus_match(address)) {
+    uint16_t w = cpu_bus_access(address, 1, (address&1)?1:2, 0);
+    return (address&1)?(w & 0xff):(w >> 8);
+  }
+  unsigned char *p = cpu_ptr(address, 1);
+  return p?p[0]:0xff;
+}
+
+unsigned int m68k_read_memory_16(unsigned int address) {
+  address &= 0xffffff;
+  if(cpu_bus_match(address))
+    return cpu_bus_access(address, 1, 3, 0);
+  unsigned char *p = cpu_ptr(address, 2);
+  return p?(256*p[0] + p[1]):0xffff;
+}
+
+unsigned int m68k_read_memory_32(unsigned int address) {
+  return (m68k_read_memory_16(address) << 16) | m68k_read_memory_16(address+2);
+}
+
+void m68k_write_memory_8(unsigned int address, unsigned int value) {
+  address &= 0xffffff;
+  if(cpu_bus_match(address)) {
+    cpu_bus_access(address, 0, (address&1)?1:2, (value & 0xff) * 0x101);
+    return;
+  }
+  unsigned char *p = cpu_ptr(address, 1);
+  if(p) p[0] = value;
+}
+
+void m68k_write_memory_16(unsigned int address, unsigned int value) {
+  address &= 0xffffff;
+  if(cpu_bus_match(address)) {
+    cpu_bus_access(address, 0, 3, value);
+    return;
+  }
+  unsigned char *p = cpu_ptr(address, 2);
+  if(p) { p[0] = value >> 8; p[1] = value; }
+}
+
+void m68k_write_memory_32(unsigned int address, unsigned int value) {
+  m68k_write_memory_16(address, value >> 16);
+  m68k_write_memory_16(address+2, value);
+}
+
+}
+
+#define CPU_STOP_OPCODE 0x4e72
+
+static void cpu_thread(void) {
+  for(;;) {
+    cpu_insn_io = 0;
+    int cycles = m68k_execute(1);
+
+    if(m68k_get_reg(NULL, M68K_REG_IR) == CPU_STOP_OPCODE) {
+      cpu_stopped = 1;
+      cpu_yield(~0ull >> 1);
+    }
+
+    cpu_instructions++;
+    cpu_cycles += cycles;
+
+    // the model accesses of the instruction already took their time
+    if(cycles > 4*cpu_insn_io)
+      cpu_yield(cycles - 4*cpu_insn_io);
+  }
+}
+
+static inline void cpu_map(ram_t *ram) {
+  cpu_maps[cpu_nmaps++] = ram;
+}
+
+// load the program to the begin of ram and bind the cpu to the bus
+template<class T> int cpu_init(st_bus_t<T> *bus, ram_t *ram, const char *name) {
+  FILE *f = fopen(name, "rb");
+  if(!f) { perror(name); return -1; }
+  int len = fread(ram->mem, 1, ram->size, f);
+  fclose(f);
+  printf("cpu: %d bytes loaded from %s to $%x\n", len, name, ram->base);
+
+  if(ram->base) {
+    cpu_vectors.init(0, 8);
+    cpu_vectors.write16(0, (ram->base + ram->size) >> 16);
+    cpu_vectors.write16(2, ram->base + ram->size);
+    cpu_vectors.write16(4, ram->base >> 16);
+    cpu_vectors.write16(6, ram->base);
+    cpu_map(&cpu_vectors);
+  }
+  cpu_map(ram);
+  cpu_bus = bus;
+  cpu_bus_match = [](uint32_t a) -> int {
+    st_bus_t<T> *b = (st_bus_t<T>*)cpu_bus;
+    return (a & b->mask) == b->base;
+  };
+  cpu_bus_post = [](uint32_t a, int rw, int ds, uint16_t d) {
+    st_bus_t<T> *b = (st_bus_t<T>*)cpu_bus;
+    b->ds = ds;
+    if(rw) b->rd_addr = a;
+    else { b->wr_addr = a; b->wr_data = d; }
+  };
+  cpu_bus_slot = []() -> int { return ((st_bus_t<T>*)cpu_bus)->top->bus_cycle == 0; };
+  cpu_bus_data = []() -> uint16_t { return ((st_bus_t<T>*)cpu_bus)->rd_data; };
+
+  m68k_init();
+  m68k_set_cpu_type(M68K_CPU_TYPE_68000);
+
+  getcontext(&cpu_ctx);
+  cpu_ctx.uc_stack.ss_sp = malloc(CPU_STACK);
+  cpu_ctx.uc_stack.ss_size = CPU_STACK;
+  cpu_ctx.uc_link = NULL;
+  makecontext(&cpu_ctx, cpu_thread, 0);
+  return 0;
+}
+
+// leave reset, the cpu starts at the next clock
+static inline void cpu_start(void) {
+  m68k_pulse_reset();
+  cpu_resume = cpu_clocks;
+  cpu_running = 1;
+}
+
+// the bus model drives a posted access at this edge in the cpu's slot
+static inline void cpu_drive(void) {
+  if(cpu_io == 1 && cpu_bus_slot()) {
+    cpu_io = 2;
+    cpu_resume = cpu_clocks + 4;
+  }
+}
+
+// rising edge of the 8MHz cpu clock
+static inline void cpu_clock(void) {
+  if(!cpu_running) return;
+  cpu_clocks++;
+
+  cpu_drive();
+  if(cpu_clocks < cpu_resume) return;
+  cpu_io = 0;
+
+  swapcontext(&cpu_main_ctx, &cpu_ctx);
+  cpu_drive();
+}
+
+static inline void cpu_report(void) {
+  printf("cpu: %s after %llu clocks, %llu instructions, %llu cycles\n",
+	 cpu_stopped?"stopped":"running", cpu_clocks, cpu_instructions, cpu_cycles);
+  printf("cpu: %llu bus accesses, %llu stall cycles (%.2f per access)\n",
+	 cpu_io_accesses, cpu_stalls,
+	 cpu_io_accesses?(double)cpu_stalls/cpu_io_accesses:0.0);
+}
+
+#endif // CPU68K_H
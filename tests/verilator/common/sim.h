@@ -0,0 +1,137 @@
+// sim.h
+//
+// Event scheduler for the verilator testbenches. Time is kept in integer
+// picoseconds. Clocks toggle their model input at exact edge times and
+// the model is only evaluated on clock edges and once at the begin of
+// each wait, for the inputs the testbench changed in between.
+//
+// Per clock edge the order is:
+//   toggle clock, pre(level), eval, post(level), eval if post returned 1
+// pre() sees the model outputs from before the edge, post() those after.
+
+#ifndef SIM_H
+#define SIM_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "trace.h"
+
+typedef uint64_t sim_time_t;
+
+#define SIM_NS(a)  ((sim_time_t)((a)*1000.0+0.5))
+#define SIM_US(a)  ((sim_time_t)((a)*1000000.0+0.5))
+
+#define SIM_MAX_CLOCKS 8
+
+typedef struct {
+  CData *sig;                // model input or NULL for a pure timer
+  uint64_t hz;
+  sim_time_t start, next;
+  uint64_t edges;
+  int level;
+  void (*pre)(int level);
+  int (*post)(int level);
+} sim_clock_t;
+
+static sim_time_t sim_time = 0;
+static unsigned long long sim_evals = 0;
+static sim_clock_t sim_clocks[SIM_MAX_CLOCKS];
+static int sim_nclocks = 0;
+
+// traces are written while sim_trace is set
+static int sim_trace = 1;
+
+// called after each evaluation, e.g. to watch outputs
+static void (*sim_eval_hook)(void) = NULL;
+
+static void *sim_top = NULL;
+static void (*sim_model_eval)(void) = NULL;
+
+template<class T> void sim_init(T *top) {
+  sim_top = top;
+  sim_model_eval = [](){ ((T*)sim_top)->eval(); };
+}
+
+static inline void sim_eval(void) {
+  sim_model_eval();
+  sim_evals++;
+  if(sim_trace) trace_dump(sim_time);
+  if(sim_eval_hook) sim_eval_hook();
+}
+
+// edges are computed from the edge count, so there's no rounding drift
+static inline sim_time_t sim_clock_edge(sim_clock_t *c, uint64_t n) {
+  return c->start + (sim_time_t)((unsigned __int128)n * 500000000000ull / c->hz);
+}
+
+// a clock of hz, first edge half a period from now
+static inline sim_clock_t *sim_add_clock(CData *sig, double hz,
+				  void (*pre)(int) = NULL, int (*post)(int) = NULL) {
+  sim_clock_t *c = &sim_clocks[sim_nclocks++];
+
+  c->sig = sig;
+  c->hz = hz;
+  c->start = sim_time;
+  c->edges = 1;
+  c->level = sig?*sig:0;
+  c->next = sim_clock_edge(c, 1);
+  c->pre = pre;
+  c->post = post;
+  return c;
+}
+
+// remove all clocks, e.g. to run again with other frequencies
+static inline void sim_remove_clocks(void) {
+  sim_nclocks = 0;
+}
+
+static inline void sim_wait_ps(sim_time_t n) {
+  sim_time_t end = sim_time + n;
+  int i;
+
+  sim_eval();
+
+  for(;;) {
+    sim_time_t next = end+1;
+    for(i=0;i<sim_nclocks;i++)
+      if(sim_clocks[i].next < next)
+	next = sim_clocks[i].next;
+    if(next > end) break;
+
+    sim_time = next;
+
+    // all clocks with an edge now change together
+    for(i=0;i<sim_nclocks;i++) {
+      sim_clock_t *c = &sim_clocks[i];
+      if(c->next != next) continue;
+      c->level = !c->level;
+      if(c->sig) *c->sig = c->level;
+      if(c->pre) c->pre(c->level);
+    }
+
+    sim_eval();
+
+    int again = 0;
+    for(i=0;i<sim_nclocks;i++) {
+      sim_clock_t *c = &sim_clocks[i];
+      if(c->next != next) continue;
+      if(c->post) again |= c->post(c->level);
+      c->next = sim_clock_edge(c, ++c->edges);
+    }
+
+    if(again) sim_eval();
+  }
+
+  sim_time = end;
+}
+
+static inline void sim_report(void) {
+  printf("%.3f us simulated, %llu evaluations\n", sim_time/1000000.0, sim_evals);
+}
+
+static inline void sim_wait_ns(double n) { sim_wait_ps(SIM_NS(n)); }
+static inline void sim_wait_us(double n) { sim_wait_ps(SIM_US(n)); }
+static inline void sim_wait_ms(double n) { sim_wait_ps(SIM_US(n*1000.0)); }
+
+#endif // SIM_H
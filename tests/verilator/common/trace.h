@@ -0,0 +1,177 @@
+// trace.h
+//
+// Runtime controlled signal tracing for the verilator testbenches.
+// The environment selects what is written:
+//
+// TRACE        off (default), all, window or ring
+// TRACE_START  begin of the window in us
+// TRACE_END    end of the window in us
+// TRACE_RING   length of the flight recorder in us (default 100)
+// TRACE_FILE   trace file, default <name>.vcd or <name>.fst
+//
+// "ring" keeps the trace in memory and only writes the last TRACE_RING
+// to TRACE_RING*2 us when the testbench calls trace_fail(). Models built
+// with TRACE_FST (make FST=1) write fst files, the ring needs vcd.
+// trace_dump() takes the time in ps like the scheduler in sim.h.
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+#include "verilated.h"
+
+#ifdef TRACE_FST
+#include "verilated_fst_c.h"
+typedef VerilatedFstC trace_file_t;
+#define TRACE_EXT ".fst"
+#else
+#include "verilated_vcd_c.h"
+typedef VerilatedVcdC trace_file_t;
+#define TRACE_EXT ".vcd"
+#endif
+
+enum { TRACE_OFF=0, TRACE_ALL, TRACE_WINDOW, TRACE_RING };
+
+static int trace_mode = TRACE_OFF;
+static int trace_open = 0;
+static trace_file_t *trace_tfp = NULL;
+static std::string trace_name;
+static vluint64_t trace_start = 0, trace_end = ~0ull;
+static vluint64_t trace_ring = 100000000, trace_seg = 0;
+
+#ifndef TRACE_FST
+// the vcd writer calls open() for each new segment. Each segment begins
+// with a full dump, so the header followed by the last two segments is
+// a valid vcd
+class TraceRing : public VerilatedVcdFile {
+public:
+  std::string header, seg[2];
+  int cur = 0;
+
+  virtual bool open(const std::string &name) {
+    cur ^= 1;
+    seg[cur].clear();
+    return true;
+  }
+  virtual void close() { }
+  virtual ssize_t write(const char *buf, ssize_t len) {
+    seg[cur].append(buf, len);
+    return len;
+  }
+};
+
+static TraceRing *trace_ring_file = NULL;
+#endif
+
+static vluint64_t trace_env_us(const char *name, vluint64_t def) {
+  return getenv(name)?(vluint64_t)(atof(getenv(name))*1000000):def;
+}
+
+template<class T> void trace_init(T *top, const char *name, int levels = 99) {
+  const char *mode = getenv("TRACE");
+
+  if(!mode || !strcmp(mode, "off"))   return;
+  else if(!strcmp(mode, "all"))       trace_mode = TRACE_ALL;
+  else if(!strcmp(mode, "window"))    trace_mode = TRACE_WINDOW;
+  else if(!strcmp(mode, "ring"))      trace_mode = TRACE_RING;
+  else {
+    fprintf(stderr, "TRACE must be off, all, window or ring\n");
+    exit(-1);
+  }
+
+  trace_name = getenv("TRACE_FILE")?getenv("TRACE_FILE"):std::string(name) + TRACE_EXT;
+  trace_start = trace_env_us("TRACE_START", 0);
+  trace_end = trace_env_us("TRACE_END", ~0ull);
+  trace_ring = trace_env_us("TRACE_RING", 100000000);
+
+  Verilated::traceEverOn(true);
+
+#ifdef TRACE_FST
+  if(trace_mode == TRACE_RING) {
+    fprintf(stderr, "TRACE=ring needs a vcd build\n");
+    exit(-1);
+  }
+#else
+  if(trace_mode == TRACE_RING) {
+    trace_ring_file = new TraceRing;
+    trace_tfp = new VerilatedVcdC(trace_ring_file);
+    top->trace(trace_tfp, levels);
+    trace_tfp->open(trace_name.c_str());
+
+    // the header is only written by open()
+    trace_tfp->flush();
+    trace_ring_file->header.swap(trace_ring_file->seg[trace_ring_file->cur]);
+    trace_open = 1;
+    return;
+  }
+#endif
+
+  trace_tfp = new trace_file_t;
+  top->trace(trace_tfp, levels);
+  if(trace_mode == TRACE_ALL) {
+    trace_tfp->open(trace_name.c_str());
+    trace_open = 1;
+  }
+}
+
+static inline void trace_dump(vluint64_t t) {
+  if(!trace_mode) return;
+
+  if(trace_mode == TRACE_WINDOW) {
+    if(t < trace_start) return;
+    if(t > trace_end) {
+      if(trace_open) trace_tfp->close();
+      trace_mode = TRACE_OFF;
+      trace_open = 0;
+      return;
+    }
+
+    if(!trace_open) {
+      trace_tfp->open(trace_name.c_str());
+      trace_open = 1;
+    }
+  }
+
+#ifndef TRACE_FST
+  // start a new segment, the one before the last is dropped
+  if(trace_mode == TRACE_RING && t - trace_seg >= trace_ring) {
+    trace_tfp->openNext(false);
+    trace_seg = t;
+  }
+#endif
+
+  trace_tfp->dump(t);
+}
+
+// end of the simulation. The ring is discarded
+static inline void trace_close(void) {
+  if(trace_open) trace_tfp->close();
+  trace_mode = TRACE_OFF;
+  trace_open = 0;
+}
+
+// a check failed, write the ring
+static inline void trace_fail(void) {
+#ifndef TRACE_FST
+  if(trace_mode == TRACE_RING) {
+    TraceRing *r = trace_ring_file;
+    trace_tfp->flush();
+
+    FILE *f = fopen(trace_name.c_str(), "w");
+    if(!f) { perror(trace_name.c_str()); return; }
+    fwrite(r->header.data(), 1, r->header.size(), f);
+    fwrite(r->seg[r->cur^1].data(), 1, r->seg[r->cur^1].size(), f);
+    fwrite(r->seg[r->cur].data(), 1, r->seg[r->cur].size(), f);
+    fclose(f);
+
+    printf("trace ring written to %s\n", trace_name.c_str());
+  }
+#endif
+  trace_close();
+}
+
+#endif // TRACE_H
@@ -0,0 +1,49 @@
+; 68000 driver code for the co-simulation in dma_tb.cpp. Programs the
+; dma to receive one sector at $fc0000 like TOS does, waits for the
+; dma address to reach the end of the sector and sums up the data.
+; Returns the sum in d0 and the dma address in d1
+
+dmahigh	equ	$ff8609
+dmamid	equ	$ff860b
+dmalow	equ	$ff860d
+dmac	equ	$ff8606
+fdcc	equ	$ff8604
+buffer	equ	$fc0000
+
+	org	0
+	dc.l	$10000		; initial ssp
+	dc.l	start		; initial pc
+
+start:	move.l	#buffer,d0
+	move.b	d0,dmalow
+	lsr.l	#8,d0
+	move.b	d0,dmamid
+	lsr.l	#8,d0
+	move.b	d0,dmahigh
+
+	; toggle the direction to clear the fifo, then select the
+	; sector count register and start the dma with one sector
+	move.w	#$190,dmac
+	move.w	#$090,dmac
+	move.w	#1,fdcc
+
+	; wait for the last word, with a timeout
+	move.l	#buffer+512,d2
+	move.w	#10000,d3
+wait:	moveq	#0,d1
+	move.b	dmahigh,d1
+	lsl.l	#8,d1
+	move.b	dmamid,d1
+	lsl.l	#8,d1
+	move.b	dmalow,d1
+	cmp.l	d2,d1
+	dbeq	d3,wait
+
+	; sum up the received words
+	lea	buffer,a0
+	moveq	#0,d0
+	move.w	#255,d3
+sum:	add.w	(a0)+,d0
+	dbra	d3,sum
+
+	stop	#$2700
@@ -1,19 +1,21 @@
 // TODO: include real tos.c
 
+#include <time.h>
+
 #include "Vdma.h"
 #include "verilated.h"
-#include "verilated_vcd_c.h"
+#include "sim.h"
+#include "bus.h"
+#ifdef MUSASHI
+#include "cpu68k.h"
+#endif
 
 Vdma* top = NULL;
-VerilatedVcdC* tfp = NULL;
-
-double time_ns = 0;
 
 #define MEMBASE 0xfc0000
 #define MEMSIZE 256*1024
-unsigned char mem[MEMSIZE];
+unsigned char *mem;
 
-#define MHZ2NS(a)  (1000000000.0/(a))
 #define CLK        (8000000.0)
 
 void hexdump(void *data, int size) {
@@ -36,172 +38,74 @@ void hexdump(void *data, int size) {
   }
 }
 
-unsigned long cpu_read_addr = 0;
-unsigned short cpu_read_data;
-
-unsigned long cpu_write_addr = 0;
-unsigned short cpu_write_data;
-
-void eval(void) {
-  static int last_clk = 0;
+st_bus_t<Vdma> bus;
+ram_t ram;
+spi_master_t spi;
 
-  // evaluate recent changes
-  top->eval();
-  tfp->dump(time_ns);
-
-  // eval on negedge of clk
-  if(!top->clk && last_clk) {
-
-    // check if someone wants to read
-    if(top->ram_read) {
-      unsigned short data = 0;
-      unsigned long addr = top->ram_addr<<1;
-      unsigned char *ptr = mem+addr-MEMBASE;
-      
-      if((addr >= MEMBASE) && (addr < MEMBASE+MEMSIZE))
-	data = 256*ptr[0] + ptr[1];
-      else
-	printf("Reading outside range: %lx\n", addr);
-
-      //      printf("    RAM_READ(%lx)=%x\n", addr, data);
-      top->ram_din = data;
-    }
-    
-    // check if someone wants to write
-    if(top->ram_write) {
-      unsigned long addr = top->ram_addr<<1;
-      unsigned short data = 
-	((top->ram_dout & 0xff)<<8) | ((top->ram_dout & 0xff00)>>8);
-      
-      //      printf("    RAM_WRITE(%lx, %x)\n", addr, top->ram_dout);
-      
-      if((addr >= MEMBASE) && (addr < MEMBASE+MEMSIZE)) 
-	*(unsigned short*)(mem+addr-MEMBASE) = data;
-      else
-	printf("Writing outside range: %lx\n", addr);
-    }
-  }
-  last_clk = top->clk;
+// the cpu bus is driven with the edges of the 8MHz clock
+void clk_edge(int level) {
+  if(level) {
+    top->bus_cycle = (top->bus_cycle + 1)&3;
+#ifdef MUSASHI
+    cpu_clock();
+#endif
+    bus.posedge();
+  } else
+    bus.negedge();
 }
 
-// advance time and create valid 8 Mhz clock and signals
-// derived from it 
-void wait_ns(double n) {
-  static int clk_time = 0;
-
-  eval();
-
-  // check if next clk event is within waiting period
-  while(clk_time <= n) {
-    time_ns += clk_time;    // advance time to next clk event
-    n -= clk_time;          // reduce remainung waiting time
+// benchmark statistics, collected while bench_active is set
+int bench_active = 0;
+unsigned long bench_ram_words;
+unsigned long bench_fifo_hist[16], bench_clocks;
+sim_time_t bench_t0, bench_first_ram, bench_last_ram;
 
-    // process change on clk 
-    top->clk = !top->clk;
+// memory is accessed on the falling edge
+int clk_mem(int level) {
+  if(level) return 0;
 
-    // cpu reads on falling clock edge
-    if((!top->clk) && (top->bus_cycle == 0)) {
-      // read access in progress?
-      if(top->cpu_sel && top->cpu_rw) {
-	cpu_read_data = top->cpu_dout;
-	cpu_read_addr = 0;
-      }
-    }
+  if(bench_active) {
+    bench_fifo_hist[(top->v__DOT__fifo_wptr - top->v__DOT__fifo_rptr)&15]++;
+    bench_clocks++;
 
-    if(top->clk) {
-      // do everything that's supposed to happen on the rising
-      // edge of clk
-      top->bus_cycle = (top->bus_cycle + 1)&3;
-      top->cpu_sel = 0;	  
-
-      if(top->bus_cycle == 0) {
-	if(cpu_read_addr) {
-	  // perform cpu read access
-	  top->cpu_sel = (cpu_read_addr & ~0xf) == 0xff8600;
-	  top->cpu_addr = (cpu_read_addr & 0x0f)>>1;
-	  top->cpu_rw = 1;
-	  top->cpu_uds = top->cpu_lds = 0;
-	} 
-
-	// perform cpu write access
-	if(cpu_write_addr) {
-	  top->cpu_sel = (cpu_write_addr & ~0xf) == 0xff8600;
-	  top->cpu_addr = (cpu_write_addr & 0x0f)>>1;
-	  top->cpu_rw = 0;
-	  top->cpu_din = cpu_write_data;
-	  top->cpu_uds = top->cpu_lds = 0;
-	  cpu_write_addr = 0;
-	}
-      }
+    if(top->ram_read || top->ram_write) {
+      if(!bench_ram_words++) bench_first_ram = sim_time;
+      bench_last_ram = sim_time;
     }
-
-    eval();
-
-    clk_time = MHZ2NS(CLK)/2; // next clk change in 62.5ns
   }
 
-  // next event is when done waiting
-  time_ns += n; // advance time
-  clk_time -= n;
-}
-
-void wait_us(double n) {
-  wait_ns(n * 1000.0);
-}
-
-void wait_ms(double n) {
-  wait_us(n * 1000.0);
-}
+  if(top->ram_read) {
+    //      printf("    RAM_READ(%x)\n", top->ram_addr<<1);
+    top->ram_din = ram.read16(top->ram_addr<<1);
+  }
 
-void cpu_write(unsigned long addr, unsigned short data) {
-  cpu_write_addr = addr;
-  cpu_write_data = data;
-  wait_us(1);               // wait two 2MHz system cycles
-}
+  if(top->ram_write) {
+    //      printf("    RAM_WRITE(%x, %x)\n", top->ram_addr<<1, top->ram_dout);
+    ram.write16(top->ram_addr<<1, top->ram_dout);
+  }
 
-unsigned short cpu_read(unsigned long addr) {
-  cpu_read_addr = addr;
-  wait_us(1);               // wait two 2MHz system cycles
-  return cpu_read_data;
+  return top->ram_read;
 }
 
 #define SPI_CLK  24000000.0
-#define SPI_CLK_NS  MHZ2NS(SPI_CLK)
 
-// send a byte over spi
+// send a byte over spi at 24Mhz
 unsigned char SPI(unsigned char byte) {
-  unsigned char bit;
-  unsigned char retval = 0;
-
-  // spi at 24Mhz: complete cycle = 41.6666ns
-
-  // data has to be stable on pos edge of sck
-  for(bit=0;bit<8;bit++) {
-    wait_ns(SPI_CLK_NS/4);
-    top->sck = 0;
-    wait_ns(SPI_CLK_NS/4);
-    top->sdi = (byte & (0x80>>bit))?1:0;
-    retval = (retval << 1) | (top->sdo?1:0);
-    wait_ns(SPI_CLK_NS/4);
-    top->sck = 1;
-    wait_ns(SPI_CLK_NS/4);
-  }
-
-  return retval;
+  return spi.transfer(byte);
 }
 
 #define SPI_WRITE(a) SPI(a)
 
 void EnableFpga(void) {
-  wait_ns(100);
+  sim_wait_ns(100);
   top->ss = 0;
-  wait_ns(100);
+  sim_wait_ns(100);
 }
 
 void DisableFpga(void) {
-  wait_ns(200);
+  sim_wait_ns(200);
   top->ss = 1;
-  wait_ns(10);
+  sim_wait_ns(10);
 }
 
 // ------- routines takes from firmware tos.c ----------------
@@ -312,20 +216,20 @@ static void spi_noise() {
 void dma_address_verify(unsigned long a, unsigned char s, char rw) {
   unsigned char buffer[16];
 
-  wait_us(5);
+  sim_wait_us(5);
 
   // check that address has advanced correctly
   if((top->ram_addr<<1) != a) {
     printf("ERROR: DMA address is %x, should be %lx\n", 
 	   top->ram_addr<<1, a);
-    tfp->close();
+    trace_fail();
     exit(0);
   }
 
   if(top->v__DOT__dma_scnt != s) {
     printf("  ERROR: Sector count is %d, should be %d\n", 
 	   top->v__DOT__dma_scnt, s);
-    tfp->close();
+    trace_fail();
     exit(0);
   }
 
@@ -333,31 +237,31 @@ void dma_address_verify(unsigned long a, unsigned char s, char rw) {
   if(top->v__DOT__dma_direction_out != rw) {
     printf("  ERROR: Direction is incorrect, is %d, should be %d\n", 
 	   top->v__DOT__dma_direction_out, rw);
-    tfp->close();
+    trace_fail();
     exit(0);
   }
 
   // cpu only works if system is not in reset
   if(!top->reset) {
     unsigned long cpu_dma_addr = 
-      (cpu_read(0xFF8609)<<16) | (cpu_read(0xFF860B)<<8) | cpu_read(0xFF860D);
+      (bus.read(0xFF8609)<<16) | (bus.read(0xFF860B)<<8) | bus.read(0xFF860D);
   
     // check that dma address visible to cpu matches
     if(cpu_dma_addr != a) { 
       printf("ERROR: cpu visible DMA address is %lx, should be %lx\n", 
 	     cpu_dma_addr, a);
-      tfp->close();
+      trace_fail();
       exit(0);
     }
     
     // enable access to sector count register
-    cpu_write(0xFF8606, 0x10);
+    bus.write(0xFF8606, 0x10);
 
-    unsigned char cpu_dma_scnt = cpu_read(0xFF8604);
+    unsigned char cpu_dma_scnt = bus.read(0xFF8604);
     if(cpu_dma_scnt != s) {
       printf("  ERROR: CPU visible sector count is %d, should be %d\n", 
 	     cpu_dma_scnt, s);
-      tfp->close();
+      trace_fail();
       exit(0);
     }
   }
@@ -373,14 +277,14 @@ void dma_address_verify(unsigned long a, unsigned char s, char rw) {
   if(ioc_dma_addr != a) { 
     printf("ERROR: io controller visible DMA address is %lx, should be %lx\n", 
 	   ioc_dma_addr, a);
-    tfp->close();
+    trace_fail();
     exit(0);
   }
   
   if(buffer[3] != s) {
     printf("  ERROR: IO controller visible sector count is %d, should be %d\n",
 	   buffer[3], s);
-    tfp->close();
+    trace_fail();
     exit(0);
   }
 
@@ -395,7 +299,7 @@ void port_test() {
   tos_set_video_adjust(0x12, 0x34);
   if(top->video_adj != 0x1234) {
     printf("ERROR: setting vadj failed\n");
-    tfp->close();
+    trace_fail();
     exit(1);
   } else
     printf("  Video adjustment ok\n");
@@ -403,7 +307,7 @@ void port_test() {
   mist_set_control(0x12345678);
   if(top->ctrl_out != 0x12345678) {
     printf("ERROR: setting control failed\n");
-    tfp->close();
+    trace_fail();
     exit(1);
   } else
     printf("  Control register write ok\n");
@@ -449,17 +353,17 @@ void dma_cpu_test() {
   dma_mode_dump();
 
   // set dma address
-  cpu_write(0xFF8609, 0xfc);
-  cpu_write(0xFF860B, 0x00);
-  cpu_write(0xFF860D, 0x00);
+  bus.write(0xFF8609, 0xfc);
+  bus.write(0xFF860B, 0x00);
+  bus.write(0xFF860D, 0x00);
   
   // enable access to sector count register
-  cpu_write(0xFF8606, 0x10);
+  bus.write(0xFF8606, 0x10);
 
   dma_mode_dump();
 
   // write 1 to sector counter register (starts dma on write to io controller)
-  cpu_write(0xFF8604, 0x01);
+  bus.write(0xFF8604, 0x01);
 
   dma_mode_dump();
 
@@ -475,20 +379,20 @@ void dma_cpu_test() {
   mist_get_dmastate(buffer);
 
   // a2 = dmac, a3 = fdcc
-  cpu_write(dmac, 0x82); // *Track register
+  bus.write(dmac, 0x82); // *Track register
   dma_mode_dump();
   
-  printf("current track = %d\n", cpu_read(fdcc)); //* Current track
-  cpu_write(fdcc, 0x01);
-  printf("current track = %d\n", cpu_read(fdcc)); //* Current track
+  printf("current track = %d\n", bus.read(fdcc)); //* Current track
+  bus.write(fdcc, 0x01);
+  printf("current track = %d\n", bus.read(fdcc)); //* Current track
 
-  cpu_write(dmac, 0x86); // *Data register
-  cpu_write(fdcc, 0x01);
+  bus.write(dmac, 0x86); // *Data register
+  bus.write(fdcc, 0x01);
 
   mist_get_dmastate(buffer);
 
   printf("181:\n");
-  cpu_write(dmac, 0x181); // *Data register
+  bus.write(dmac, 0x181); // *Data register
 
   dma_mode_dump();
 
@@ -535,7 +439,7 @@ void io_write_test(char *data, int size, int chunk_size) {
   } else
     mist_memory_write(data, size/2);
 	  
-  wait_us(5);
+  sim_wait_us(5);
 
   // check that data has arrived in memory
   if(memcmp(data, mem, bytes) != 0) {
@@ -547,7 +451,7 @@ void io_write_test(char *data, int size, int chunk_size) {
     hexdump(data, 32);
     hexdump(mem, 32);
 
-    tfp->close();
+    trace_fail();
     exit(0);
   } else
     printf("  %ld bytes successfully verified\n", bytes);
@@ -590,7 +494,7 @@ void io_read_test(char *data, int size, int chunk_size) {
   // A whole turbo dma read of 16 bytes takes 8*250ns = 2us. 
   // We can start earlier since only one word has to be arrived
   // in the fifo for us to read. 
-  wait_us(1);
+  sim_wait_us(1);
 
   if(chunk_size > 0) {
     spi_noise();
@@ -621,30 +525,195 @@ void io_read_test(char *data, int size, int chunk_size) {
     hexdump(mem, 48);
     hexdump(test_rx, 48);
 
-    tfp->close();
+    trace_fail();
     exit(0);
   } else
     printf("  %ld bytes successfully verified\n", size);
 
   // the DMA will reload after this, so wait some time for it to get
   // into a stable (non-empty) state again
-  wait_us(5);
+  sim_wait_us(5);
 
   dma_address_verify(MEMBASE+bytes, (bytes&0x1ff)?1:0, 1);
 }
 
+// ------------------------- benchmark -------------------------
+// BENCH=1 sweeps transfer size, chunk size and turbo for both
+// directions instead of running the tests. Per run it reports
+//   eff    payload bytes per simulated second from the begin of the
+//          transfer until the last word is in ram (write) or has been
+//          received by the io controller (read)
+//   bus    ram words * 2 per simulated second between the first and
+//          the last dma access on the ST bus
+//   lat    first word latency of reads, from the end of the address
+//          command until the dma reads the first word from ram
+//   fifo   fifo occupancy in percent of the 8MHz clocks
+
+static const int bench_sizes[]  = { 512, 4096, 16384 };
+static const int bench_chunks[] = { 0, 32, 512 };
+
+static double wall_time(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec/1e9;
+}
+
+static void bench_start(void) {
+  memset(bench_fifo_hist, 0, sizeof(bench_fifo_hist));
+  bench_clocks = bench_ram_words = 0;
+  bench_t0 = sim_time;
+  bench_active = 1;
+}
+
+static void bench_run(int out, int size, int chunk, int turbo, unsigned char *test) {
+  unsigned char rx[size];
+  unsigned char scnt = (size+511)/512;
+  double wall = wall_time();
+  sim_time_t t_start = sim_time, t_done;
+  int s, cs, i;
+
+  top->turbo = turbo;
+  if(!chunk) chunk = size;
+
+  if(!out) {
+    memset(mem, 0, size);
+    mist_memory_set_address(MEMBASE, scnt, 0);
+    bench_start();
+    for(s=0;s<size;s+=cs) {
+      cs = (size-s >= chunk)?chunk:size-s;
+      mist_memory_write((char*)test+s, cs/2);
+    }
+    // let the fifo drain
+    sim_wait_us(5);
+    t_done = bench_last_ram;
+  } else {
+    memcpy(mem, test, size);
+    mist_memory_set_address(MEMBASE, scnt, 1);
+    bench_start();
+    // like the firmware give the dma time to fetch the first words
+    sim_wait_us(1);
+    for(s=0;s<size;s+=cs) {
+      cs = (size-s >= chunk)?chunk:size-s;
+      mist_memory_read((char*)rx+s, cs/2);
+    }
+    t_done = sim_time;
+  }
+  bench_active = 0;
+
+  if(memcmp(out?rx:mem, test, size)) {
+    printf("ERROR: %s of %d bytes in %d byte chunks failed\n",
+	   out?"read":"write", size, chunk);
+    trace_fail();
+    exit(1);
+  }
+
+  double eff = size / ((t_done - bench_t0)/1e12);
+  double bus = (bench_ram_words > 1)?
+    2.0*(bench_ram_words-1) / ((bench_last_ram - bench_first_ram)/1e12):0;
+  double speed = (sim_time - t_start)/1e6 / (wall_time() - wall);
+
+  printf("%-5s %6d %6d %5d %9.0f %9.0f ", out?"read":"write", size,
+	 chunk, turbo, eff/1000, bus/1000);
+  if(out) printf("%7.0f", (bench_first_ram - bench_t0)/1000.0);
+  else    printf("%7s", "-");
+  printf(" %9.0f\n", speed);
+
+  printf("  fifo");
+  for(i=0;i<16;i++)
+    if(bench_fifo_hist[i])
+      printf(" %d:%.1f%%", i, 100.0*bench_fifo_hist[i]/bench_clocks);
+  printf("\n");
+}
+
+void bench(void) {
+  unsigned char test[16384];
+  double wall = wall_time();
+  sim_time_t t_start = sim_time;
+  unsigned int i, s, c, t, out;
+
+  for(i=0;i<sizeof(test);i++) test[i] = random();
+
+  printf("== DMA benchmark ==\n");
+  printf("%-5s %6s %6s %5s %9s %9s %7s %9s\n", "dir", "size", "chunk", "turbo",
+	 "eff kB/s", "bus kB/s", "lat ns", "sim us/s");
+
+  for(out=0;out<2;out++)
+    for(s=0;s<sizeof(bench_sizes)/sizeof(int);s++)
+      for(c=0;c<sizeof(bench_chunks)/sizeof(int);c++)
+	for(t=0;t<2;t++)
+	  if(bench_chunks[c] < bench_sizes[s])
+	    bench_run(out, bench_sizes[s], bench_chunks[c], t, test);
+
+  printf("%.0f simulated us per wall second\n",
+	 (sim_time - t_start)/1e6 / (wall_time() - wall));
+  sim_report();
+}
+
+#ifdef MUSASHI
+// ------------------------ co-simulation ------------------------
+// CPU=dma_cpu.bin runs the 68000 driver code in dma_cpu.s against the
+// dma. The cpu programs the dma for one sector into ram, the io
+// controller side below serves it like the firmware does. The cpu then
+// returns the sum of the received words in d0 and the final dma
+// address in d1
+ram_t cpu_ram;
+
+void cosim(const char *name) {
+  unsigned char buffer[16], data[512];
+  unsigned int i, sum = 0;
+
+  cpu_ram.init(0, 64*1024);
+  if(cpu_init(&bus, &cpu_ram, name)) exit(1);
+  cpu_map(&ram);
+
+  for(i=0;i<sizeof(data);i++) data[i] = random();
+  for(i=0;i<sizeof(data);i+=2) sum += 256*data[i] + data[i+1];
+
+  printf("== 68000 co-simulation ==\n");
+  top->reset = 0;
+  cpu_start();
+
+  // poll the dma state until the cpu has set the sector count
+  do {
+    sim_wait_us(10);
+    mist_get_dmastate(buffer);
+  } while(!buffer[3] && !cpu_stopped && sim_time < SIM_US(10000));
+
+  unsigned long addr = (buffer[0] << 16) + (buffer[1] << 8) + (buffer[2]&0xfe);
+  printf("  cpu started dma to $%lx, scnt %d at %.3f us\n", addr, buffer[3], sim_time/1e6);
+  mist_memory_write((char*)data, sizeof(data)/2);
+
+  while(!cpu_stopped && sim_time < SIM_US(20000))
+    sim_wait_us(10);
+
+  unsigned int d0 = m68k_get_reg(NULL, M68K_REG_D0) & 0xffff;
+  unsigned int d1 = m68k_get_reg(NULL, M68K_REG_D1);
+  cpu_report();
+  sim_report();
+
+  if(!cpu_stopped || d0 != (sum & 0xffff) || d1 != MEMBASE+sizeof(data)) {
+    printf("ERROR: cpu saw sum $%x at $%x, expected $%x at $%lx\n",
+	   d0, d1, sum & 0xffff, MEMBASE+sizeof(data));
+    trace_fail();
+    exit(1);
+  }
+  printf("  cpu verified %lu bytes\n", sizeof(data));
+}
+#endif
+
 int main(int argc, char **argv, char **env) {
   Verilated::commandArgs(argc, argv);
   // init top verilog instance
   top = new Vdma;
+  sim_init(top);
 
   srandom(time(NULL));
 
-  // init trace dump
-  Verilated::traceEverOn(true);
-  tfp = new VerilatedVcdC;
-  top->trace (tfp, 99);
-  tfp->open ("dma.vcd");
+  // init trace dump, see trace.h
+  trace_init(top, "dma");
+
+  ram.init(MEMBASE, MEMSIZE);
+  mem = ram.mem;
 
   // initialize system inputs
   top->clk = 1;
@@ -656,22 +725,40 @@ int main(int argc, char **argv, char **env) {
   top->turbo = 0;
 
   // init cpu interface
-  top->cpu_sel <= 0;
+  top->cpu_sel = 0;
+  bus.init(top, 0xff8600, ~0xf);
 
   // init spi
   top->sdi = 1;
   top->ss = 1;
-  top->sck = 1;
+  spi.init(&top->sck, &top->sdi, &top->sdo, SPI_CLK, 1);
 
   // floppy
   top->drv_sel = 3;     // no drive delected
   top->drv_side = 0;
   top->fdc_wr_prot = 0;
 
-  wait_us(1);
+  sim_add_clock(&top->clk, CLK, clk_edge, clk_mem);
+
+  sim_wait_us(1);
 
   port_test();
 
+#ifdef MUSASHI
+  if(getenv("CPU")) {
+    cosim(getenv("CPU"));
+    trace_close();
+    exit(0);
+  }
+#endif
+
+  if(getenv("BENCH")) {
+    top->reset = 0;
+    bench();
+    trace_close();
+    exit(0);
+  }
+
   unsigned char test[2048];
   int i;
 #if 1
@@ -694,7 +781,7 @@ int main(int argc, char **argv, char **env) {
 
   if(!top->v__DOT__dma_in_progress) {
     printf("ERROR: DMA is expected to still be active after incomplete transfer\n");
-    tfp->close();
+    trace_fail();
     exit(1);
   }
     
@@ -703,7 +790,7 @@ int main(int argc, char **argv, char **env) {
 
   if(top->v__DOT__dma_in_progress) {
     printf("ERROR: DMA is expected to be stopped now\n");
-    tfp->close();
+    trace_fail();
     exit(1);
   }
 
@@ -720,11 +807,11 @@ int main(int argc, char **argv, char **env) {
 #endif
 
   top->reset = 0;
-  wait_ns(100);
+  sim_wait_ns(100);
 
   //   dma_cpu_test();
 
-  tfp->close();
+  trace_fail();
 
   exit(0);
  }
@@ -0,0 +1,246 @@
+// io_fifo_tb.cpp
+//
+// Cross clock stress test of the io controller fifo. A producer on
+// in_clk and a consumer on out_clk transfer a known byte sequence with
+// random bursts, using either the strobe (synchronized edge) or the
+// enable inputs. The consumer checks every byte. Per scenario the
+// sustained throughput, the cycles stalled on a full or empty fifo and
+// the highest fill level are reported.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Vio_fifo.h"
+#include "verilated.h"
+#include "sim.h"
+
+#ifndef DEPTH
+#define DEPTH 4
+#endif
+// the fifo holds one entry less than it has
+#define CAPACITY ((1<<DEPTH)-1)
+
+Vio_fifo* top = NULL;
+
+enum { ENABLE=0, STROBE };
+
+typedef struct {
+  const char *name;
+  double in_hz;
+  int in_mode;
+  double in_rate;      // probability per clock to start a burst
+  int in_burst;
+  double out_hz;
+  int out_mode;
+  double out_rate;
+  int out_burst;
+} scenario_t;
+
+// the fifos of the MiST are clocked by the 8MHz cpu clock (or its
+// inverse), the strobes come from the io controller
+const scenario_t scenarios[] = {
+  { "cpu_to_io",    8000000, ENABLE, 0.002,  8,  8000000, STROBE, 0.05,  1 },
+  { "io_to_cpu",    8000000, STROBE, 0.001, 16,  8000000, ENABLE, 0.05,  1 },
+  { "printer",      8000000, STROBE, 0.005,  1,  8000000, STROBE, 0.01,  1 },
+  { "async",       24000000, ENABLE, 0.01,   4,  7372800, ENABLE, 0.20,  1 },
+  { "fast_out",     8000000, ENABLE, 0.50,   1, 32000000, ENABLE, 0.30,  1 },
+  { "slow_out",     8000000, ENABLE, 0.0005,32,  2000000, STROBE, 0.20,  1 },
+  { "overload",    32000000, ENABLE, 0.50,   1,  8000000, ENABLE, 0.50,  1 },
+  { NULL }
+};
+
+// the transferred sequence
+static inline uint8_t pattern(unsigned long n) {
+  return (uint32_t)(n * 2654435761u) >> 24;
+}
+
+// one side of the fifo
+typedef struct {
+  int mode, burst;
+  double rate;
+  int pending;          // transfers left in the current burst
+  int gap;              // clocks until the next strobe may start
+  unsigned long count, stalls, cycles;
+} side_t;
+
+side_t in, out;
+int max_fill;
+unsigned long errors, transfers = 20000;
+
+// a burst starts or is still going on
+static int side_wants(side_t *s) {
+  s->cycles++;
+  if(!s->pending && drand48() < s->rate)
+    s->pending = s->burst;
+  return s->pending;
+}
+
+// both sides act on the rising edge of their clock. A strobe is high
+// for one clock and the fifo sees it one clock later, so the next
+// transfer is decided two clocks later when the fifo state is up to date
+void in_edge(int level) {
+  if(!level) return;
+
+  top->in_enable = 0;
+  top->in_strobe = 0;
+
+  if(top->reset) return;
+  if(in.gap) { in.gap--; return; }
+  if(!side_wants(&in) || in.count >= transfers) return;
+
+  if(top->full) {
+    in.stalls++;
+    return;
+  }
+
+  top->in = pattern(in.count++);
+  in.pending--;
+  if(in.mode == ENABLE) top->in_enable = 1;
+  else { top->in_strobe = 1; in.gap = 1; }
+}
+
+void out_edge(int level) {
+  if(!level) return;
+
+  top->out_enable = 0;
+  top->out_strobe = 0;
+
+  int fill = CAPACITY - top->space;
+  if(fill > max_fill) max_fill = fill;
+
+  if(top->reset) return;
+  if(out.gap) { out.gap--; return; }
+  if(!side_wants(&out)) return;
+
+  if(!top->data_available) {
+    out.stalls++;
+    return;
+  }
+
+  if(top->out != pattern(out.count)) {
+    if(errors++ < 10)
+      printf("ERROR: byte %lu is %02x, expected %02x\n", out.count,
+	     top->out, pattern(out.count));
+    if(errors == 1) trace_fail();
+  }
+  out.count++;
+  out.pending--;
+  if(out.mode == ENABLE) top->out_enable = 1;
+  else { top->out_strobe = 1; out.gap = 1; }
+}
+
+void side_init(side_t *s, int mode, double rate, int burst) {
+  memset(s, 0, sizeof(*s));
+  s->mode = mode;
+  s->rate = rate;
+  s->burst = burst;
+}
+
+// smallest DEPTH that holds the highest fill level
+int depth_needed(int fill) {
+  int d = 1;
+  while((1<<d)-1 < fill) d++;
+  return d;
+}
+
+// expected time for one side to transfer everything: waiting for a
+// burst to start and one clock per transfer, two with strobes
+double side_secs(double hz, int mode, double rate, int burst) {
+  return transfers * (1/(rate*burst) + ((mode == STROBE)?2:1)) / hz;
+}
+
+void run(const scenario_t *s) {
+  side_init(&in, s->in_mode, s->in_rate, s->in_burst);
+  side_init(&out, s->out_mode, s->out_rate, s->out_burst);
+  max_fill = errors = 0;
+
+  top->in_strobe = top->in_enable = 0;
+  top->out_strobe = top->out_enable = 0;
+
+  sim_remove_clocks();
+  sim_add_clock(&top->in_clk, s->in_hz, in_edge);
+  sim_add_clock(&top->out_clk, s->out_hz, out_edge);
+
+  top->reset = 1;
+  sim_wait_us(1);
+  top->reset = 0;
+
+  // the slower side sets the pace, give it ten times as long
+  double expected = side_secs(s->in_hz, s->in_mode, s->in_rate, s->in_burst);
+  double out_secs = side_secs(s->out_hz, s->out_mode, s->out_rate, s->out_burst);
+  if(out_secs > expected) expected = out_secs;
+
+  sim_time_t start = sim_time;
+  sim_time_t end = start + SIM_US(10*expected*1e6 + 100);
+  while(out.count < transfers && sim_time < end)
+    sim_wait_us(10);
+
+  if(out.count < transfers) {
+    errors++;
+    printf("ERROR: timeout, only %lu of %lu bytes received\n", out.count, transfers);
+    if(errors == 1) trace_fail();
+  }
+  double secs = (sim_time - start)/1e12;
+
+  char depth[16];
+  if(in.stalls) sprintf(depth, ">%d", DEPTH);
+  else          sprintf(depth, "%d", depth_needed(max_fill));
+
+  printf("%-10s %5.1f %-6s %5.1f %-6s %9.1f %8.2f%% %8.2f%% %5d %6s %lu\n",
+	 s->name, s->in_hz/1e6, s->in_mode?"strobe":"enable",
+	 s->out_hz/1e6, s->out_mode?"strobe":"enable",
+	 transfers/secs/1024, 100.0*in.stalls/in.cycles,
+	 100.0*out.stalls/out.cycles, max_fill, depth, errors);
+  fflush(stdout);
+}
+
+static int mode(const char *name) {
+  return (getenv(name) && !strcmp(getenv(name), "strobe"))?STROBE:ENABLE;
+}
+
+static double env_num(const char *name, double def) {
+  return getenv(name)?atof(getenv(name)):def;
+}
+
+int main(int argc, char **argv, char **env) {
+  Verilated::commandArgs(argc, argv);
+  // init top verilog instance
+  top = new Vio_fifo;
+  sim_init(top);
+
+  // init trace dump, see trace.h
+  trace_init(top, "io_fifo");
+
+  srand48(getenv("SEED")?atoi(getenv("SEED")):1);
+  transfers = env_num("TRANSFERS", transfers);
+
+  top->in_clk = 0;
+  top->out_clk = 0;
+
+  printf("DEPTH=%d, capacity %d, %lu transfers per scenario\n",
+	 DEPTH, CAPACITY, transfers);
+  printf("%-10s %5s %-6s %5s %-6s %9s %9s %9s %5s %6s %s\n", "scenario",
+	 "inMHz", "in", "outMHz", "out", "kB/s", "full", "empty",
+	 "fill", "DEPTH", "errors");
+
+  int failed = 0;
+
+  // a single scenario from the environment, e.g. IN_HZ=24e6
+  if(getenv("IN_HZ") || getenv("OUT_HZ")) {
+    scenario_t s = { "custom",
+		     env_num("IN_HZ", 8e6), mode("IN_MODE"), env_num("IN_RATE", 0.1), (int)env_num("IN_BURST", 1),
+		     env_num("OUT_HZ", 8e6), mode("OUT_MODE"), env_num("OUT_RATE", 0.2), (int)env_num("OUT_BURST", 1) };
+    run(&s);
+    failed = errors != 0;
+  } else {
+    for(const scenario_t *s = scenarios; s->name; s++) {
+      run(s);
+      failed |= errors != 0;
+    }
+  }
+
+  sim_report();
+  trace_close();
+  return failed;
+}
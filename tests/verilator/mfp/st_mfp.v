@@ -0,0 +1,87 @@
+// st_mfp.v
+//
+// Test wrapper for the MFP of the MiST (../../../cores/mist/mfp.v).
+// The 2.4576MHz timer clock is derived from the 128MHz clock like in
+// mist_top.v or taken from clk_ext if ext_sel is set. The cpu interface
+// uses the signal names of ../common/bus.h. The timer outputs and the
+// prescaler outputs are brought out for the testbench.
+//
+
+module st_mfp (
+      input 	    clk,
+      input 	    reset,
+      input [1:0]   bus_cycle,
+
+      // timer clock
+      input 	    clk_128,
+      input 	    ext_sel,
+      input 	    clk_ext,
+
+      // cpu register interface
+      input 	    cpu_sel,
+      input [4:0]   cpu_addr,
+      input [15:0]  cpu_din,
+      output [15:0] cpu_dout,
+      input 	    cpu_uds,
+      input 	    cpu_lds,
+      input 	    cpu_rw,
+
+      output 	    irq,
+      input 	    iack,
+
+      // timer a/b inputs
+      input 	    ta_i,
+      input 	    tb_i,
+
+      // internal state, bit 0 is timer a
+      output [3:0]  done,
+      output [3:0]  tick
+);
+
+// MFP clock like in mist_top.v
+// mfp clock is clk_128*2457600/128000000 -> 12/625 -> toggle at 24/625
+reg clk_mfp = 1'b0;
+reg [9:0] clk_mfp_div = 10'd0;
+always @(posedge clk_128) begin
+	if(clk_mfp_div < 625)
+		clk_mfp_div <= clk_mfp_div + 10'd24;
+	else begin
+		clk_mfp_div <= clk_mfp_div - 10'd625 + 10'd24;
+		clk_mfp <= ~clk_mfp;
+	end
+end
+
+assign done = { mfp.timerd_done, mfp.timerc_done, mfp.timerb_done, mfp.timera_done };
+assign tick = { mfp.timer_d.prescaler_counter == 8'd0, mfp.timer_c.prescaler_counter == 8'd0,
+		mfp.timer_b.prescaler_counter == 8'd0, mfp.timer_a.prescaler_counter == 8'd0 };
+
+wire [7:0] dout;
+assign cpu_dout = { 8'h00, dout };
+
+mfp mfp (
+	.clk      ( clk          ),
+	.reset    ( reset        ),
+	.din      ( cpu_din[7:0] ),
+	.sel      ( cpu_sel      ),
+	.addr     ( cpu_addr     ),
+	.ds       ( cpu_lds      ),
+	.rw       ( cpu_rw       ),
+	.dout     ( dout         ),
+	.irq      ( irq          ),
+	.iack     ( iack         ),
+
+	.serial_data_out_available ( ),
+	.serial_strobe_out ( 1'b0  ),
+	.serial_data_out   (       ),
+	.serial_status_out (       ),
+	.serial_strobe_in  ( 1'b0  ),
+	.serial_data_in    ( 8'h00 ),
+	.serial_data_in_full ( ),
+	.serial_status_in  ( 8'h00 ),
+
+	.clk_ext  ( ext_sel?clk_ext:clk_mfp ),
+	.t_i      ( { tb_i, ta_i } ),
+	.i        ( 8'hff        )
+);
+
+endmodule
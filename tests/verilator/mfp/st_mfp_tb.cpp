@@ -0,0 +1,312 @@
+// st_mfp_tb.cpp
+//
+// Runs the timers of the MFP in delay, event and pulse mode and measures
+// the interrupt timing. The latency is taken from the event that makes
+// the timer expire (the prescaler output in delay and pulse mode, the
+// timer input edge in event mode) to the rising irq. The intervals
+// between interrupts are compared with the period of an ideal 2.4576MHz
+// timer clock and their deviation is shown in 8MHz clocks.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Vst_mfp.h"
+#include "verilated.h"
+#include "sim.h"
+#include "bus.h"
+
+#define CLK        (8000000.0)
+#define CLK_NS     (1000000000.0/CLK)
+#define CLK_MFP    (2457600.0)
+
+#define MFP        0xfffa00
+#define REG(a)     (MFP + 2*(a) + 1)
+
+// registers
+#define AER        0x01
+#define IERA       0x03
+#define IERB       0x04
+#define IMRA       0x09
+#define IMRB       0x0a
+#define VR         0x0b
+#define TACR       0x0c
+#define TCDCR      0x0e
+#define TADR       0x0f
+
+#define VECTOR     0x40
+
+Vst_mfp* top = NULL;
+st_bus_t<Vst_mfp> bus;
+
+enum { DELAY=0, EVENT, PULSE };
+const char *mode_names[] = { "delay", "event", "pulse" };
+
+const int prescalers[] = { 1, 4, 10, 16, 50, 64, 100, 200 };
+
+// interrupt channel of timers a to d
+const int channels[] = { 13, 8, 5, 4 };
+
+typedef struct {
+  const char *name;
+  int timer;           // 0..3 = a..d
+  int mode;
+  int prescaler;       // control value 1..7, delay and pulse mode
+  int data;            // 0 = 256
+  double input_hz;     // square wave on the timer input, event and pulse mode
+} config_t;
+
+// the typical uses in the ST
+const config_t configs[] = {
+  { "a_fast",    0, DELAY, 1,   2,     0 },  // fastest usable rate
+  { "a_music",   0, DELAY, 2, 123,     0 },  // replay routine
+  { "a_slow",    0, DELAY, 7,  12,     0 },
+  { "b_delay",   1, DELAY, 4,  49,     0 },
+  { "c_200hz",   2, DELAY, 5, 192,     0 },  // system timer
+  { "d_19200",   3, DELAY, 1,   2,     0 },  // baud rate of the uart
+  { "d_slow",    3, DELAY, 7, 100,     0 },
+  { "a_event",   0, EVENT, 0,  10, 50000 },
+  { "b_hbl",     1, EVENT, 0,   1, 15625 },  // raster interrupt per line
+  { "b_lines",   1, EVENT, 0, 100, 15625 },
+  { "a_pulse",   0, PULSE, 1, 100,  1000 },  // pulse width measurement
+  { "b_pulse",   1, PULSE, 2,  50,  2000 },
+  { NULL }
+};
+
+const config_t *config;
+
+// ---------------------------------- cpu ---------------------------------------
+
+int iack_req, iack_state;
+unsigned long vector_errors;
+
+// the cpu bus is driven with the edges of the 8MHz clock. An interrupt
+// acknowledge keeps iack high for one clock
+void clk_edge(int level) {
+  if(level) {
+    top->bus_cycle = (top->bus_cycle + 1)&3;
+    bus.posedge();
+
+    if(iack_state) {
+      top->iack = 0;
+      iack_state = 0;
+    } else if(iack_req) {
+      top->iack = 1;
+      iack_req = 0;
+      iack_state = 1;
+    }
+  } else
+    bus.negedge();
+}
+
+// the cpu reads the vector while iack is high
+int clk_post(int level) {
+  if(level || !top->iack) return 0;
+
+  int expected = VECTOR | channels[config->timer];
+  if((top->cpu_dout & 0xff) != expected) {
+    if(vector_errors++ < 10)
+      printf("ERROR: vector %02x, expected %02x\n", top->cpu_dout & 0xff, expected);
+    if(vector_errors == 1) trace_fail();
+  }
+  return 0;
+}
+
+// ------------------------------- statistics -----------------------------------
+
+typedef struct {
+  unsigned long n;
+  double sum, min, max;
+} stat_t;
+
+void stat_add(stat_t *s, double v) {
+  if(!s->n || v < s->min) s->min = v;
+  if(!s->n || v > s->max) s->max = v;
+  s->sum += v;
+  s->n++;
+}
+
+double stat_avg(stat_t *s) {
+  return s->n?s->sum/s->n:0.0;
+}
+
+// deviation of the intervals from the ideal period in 8MHz clocks,
+// the outer bins collect everything beyond
+#define BINS 9
+unsigned long hist[BINS];
+
+stat_t latency, interval;
+unsigned long irqs, dones, lost;
+double period;
+
+// the edges are watched after every evaluation
+sim_time_t last_ref, last_irq;
+int last_tick, last_input, last_done, last_irq_level;
+
+void watch(void) {
+  int t = config->timer;
+  int tick = (top->tick >> t) & 1;
+  int input = t?top->tb_i:top->ta_i;
+  int done = (top->done >> t) & 1;
+
+  // the event that makes the timer count
+  if(config->mode == EVENT) {
+    if(input && !last_input) last_ref = sim_time;
+  } else if(tick && !last_tick) {
+    if(config->mode == DELAY || input) last_ref = sim_time;
+  }
+
+  if(done && !last_done) dones++;
+
+  if(top->irq && !last_irq_level) {
+    irqs++;
+    stat_add(&latency, (sim_time - last_ref)/1000.0);
+
+    // irqs lost while the previous one was pending are not counted
+    if(last_irq && dones == 1) {
+      double ns = (sim_time - last_irq)/1000.0;
+      stat_add(&interval, ns);
+      int bin = (int)((ns - period)/CLK_NS + (ns > period?0.5:-0.5)) + BINS/2;
+      if(bin < 0) bin = 0;
+      if(bin >= BINS) bin = BINS-1;
+      hist[bin]++;
+    }
+    if(dones > 1) lost += dones-1;
+    dones = 0;
+    last_irq = sim_time;
+  }
+
+  last_tick = tick;
+  last_input = input;
+  last_done = done;
+  last_irq_level = top->irq;
+}
+
+// ---------------------------------- runs --------------------------------------
+
+// the timer clock comes from the 128MHz clock like in the MiST or is an
+// ideal 2.4576MHz clock with IDEAL=1
+void clocks(void) {
+  sim_remove_clocks();
+  sim_add_clock(&top->clk, CLK, clk_edge, clk_post);
+  if(top->ext_sel) sim_add_clock(&top->clk_ext, CLK_MFP);
+  else             sim_add_clock(&top->clk_128, 128000000.0);
+}
+
+void write_reg(int reg, int val) {
+  bus.write(REG(reg), val);
+}
+
+int run(const config_t *c, int events, double ms, double ack_ns) {
+  int data = c->data?c->data:256;
+
+  config = c;
+  memset(&latency, 0, sizeof(latency));
+  memset(&interval, 0, sizeof(interval));
+  memset(hist, 0, sizeof(hist));
+  irqs = dones = lost = vector_errors = 0;
+  last_ref = last_irq = 0;
+
+  // ideal period, in pulse mode the timer counts half of the time
+  if(c->mode == EVENT) period = 1e9 * data / c->input_hz;
+  else                 period = 1e9 * prescalers[c->prescaler] * data / CLK_MFP;
+  if(c->mode == PULSE) period *= 2;
+
+  // square wave on the timer input
+  top->ta_i = top->tb_i = 0;
+  clocks();
+  if(c->input_hz)
+    sim_add_clock(c->timer?&top->tb_i:&top->ta_i, c->input_hz);
+
+  top->reset = 1;
+  sim_wait_us(2);
+  top->reset = 0;
+
+  // inputs active high, auto end of interrupt
+  write_reg(AER, 0x18);
+  write_reg(VR, VECTOR);
+  int ch = channels[c->timer];
+  write_reg((ch<8)?IERB:IERA, 1<<(ch&7));
+  write_reg((ch<8)?IMRB:IMRA, 1<<(ch&7));
+
+  write_reg(TADR + c->timer, c->data);
+  int ctrl = (c->mode == EVENT)?8:(c->mode == PULSE)?8+c->prescaler:c->prescaler;
+  if(c->timer < 2) write_reg(TACR + c->timer, ctrl);
+  else             write_reg(TCDCR, (c->timer == 2)?(ctrl<<4):ctrl);
+
+  sim_eval_hook = watch;
+
+  // the cpu acknowledges every irq after ack_ns
+  sim_time_t end = sim_time + SIM_US(ms*1000.0);
+  while(irqs < (unsigned long)events+1 && sim_time < end) {
+    if(!top->irq) {
+      sim_wait_ns(100);
+      continue;
+    }
+    sim_wait_ns(ack_ns);
+    iack_req = 1;
+    while(iack_req || iack_state)
+      sim_wait_ns(CLK_NS);
+  }
+
+  sim_eval_hook = NULL;
+
+  // stop the timer
+  if(c->timer < 2) write_reg(TACR + c->timer, 0);
+  else             write_reg(TCDCR, 0);
+
+  double avg = stat_avg(&interval);
+  printf("%-8s %c %-5s %3d %3d %10.3f %10.3f %8.0f %6.0f %6.0f %5.0f %5.0f %5.0f %4lu %s",
+	 c->name, 'a'+c->timer, mode_names[c->mode],
+	 (c->mode == EVENT)?0:prescalers[c->prescaler], data,
+	 period/1000.0, avg/1000.0, interval.n?1e6*(avg-period)/period:0.0,
+	 interval.n?interval.min-period:0.0, interval.n?interval.max-period:0.0,
+	 latency.min, stat_avg(&latency), latency.max, lost,
+	 irqs?"":"no irq");
+  for(int i=0;i<BINS && interval.n;i++)
+    printf(" %lu", hist[i]);
+  printf("\n");
+  fflush(stdout);
+
+  return !irqs || vector_errors;
+}
+
+int main(int argc, char **argv, char **env) {
+  Verilated::commandArgs(argc, argv);
+  // init top verilog instance
+  top = new Vst_mfp;
+  sim_init(top);
+
+  // init trace dump, see trace.h
+  trace_init(top, "st_mfp");
+
+  int events = getenv("EVENTS")?atoi(getenv("EVENTS")):50;
+  double ms = getenv("MS")?atof(getenv("MS")):100;
+  double ack_ns = getenv("ACK_NS")?atof(getenv("ACK_NS")):1000;
+
+  // initialize system inputs
+  top->clk = 1;
+  top->clk_128 = 0;
+  top->clk_ext = 0;
+  top->ext_sel = getenv("IDEAL")?1:0;
+  top->iack = 0;
+  top->cpu_sel = 0;
+  bus.init(top, MFP, ~0x3f);
+
+  printf("%s timer clock, %d irqs or %.0f ms per timer, irq acknowledged after %.0f ns\n",
+	 top->ext_sel?"ideal":"MiST", events, ms, ack_ns);
+  printf("%-8s %c %-5s %3s %3s %10s %10s %8s %6s %6s %5s %5s %5s %4s %s\n",
+	 "config", 't', "mode", "pre", "dat", "ideal us", "period us", "ppm",
+	 "min ns", "max ns", "lat<", "lat", "lat>", "lost",
+	 "deviation in clocks <-3 -3 .. +3 >+3");
+
+  int failed = 0;
+  for(const config_t *c = configs; c->name; c++) {
+    if(getenv("CONFIG") && strcmp(getenv("CONFIG"), c->name)) continue;
+    failed |= run(c, events, ms, ack_ns);
+  }
+
+  sim_report();
+  trace_close();
+  return failed;
+}
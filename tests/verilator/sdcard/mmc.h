@@ -72,9 +72,11 @@
 #define MMC_SEND_OP_COND			1		///< set card operational mode
 #define MMC_SEND_CSD				9		///< get card's CSD
 #define MMC_SEND_CID				10		///< get card's CID
+#define MMC_STOP_TRANSMISSION		12		///< end a multiple block read
 #define MMC_SEND_STATUS				13
 #define MMC_SET_BLOCKLEN			16		///< Set number of bytes to transfer per block
 #define MMC_READ_SINGLE_BLOCK		17		///< read a block
+#define MMC_READ_MULTIPLE_BLOCK		18		///< read blocks until MMC_STOP_TRANSMISSION
 #define MMC_WRITE_BLOCK				24		///< write a block
 #define MMC_PROGRAM_CSD				27
 #define MMC_SET_WRITE_PROT			28
@@ -134,6 +136,10 @@ void mmc_init(void);
 /// Returns zero if successful.
 u08 mmcRead(u32 sector);
 
+//! Read count 512-byte sectors from card to buffer with a single
+/// READ_MULTIPLE_BLOCK command. Returns zero if successful.
+u08 mmcReadMultiple(u32 sector, u08 *buffer, u32 count);
+
 //! Write 512-byte sector from buffer to card
 /// Returns zero if successful.
 u08 mmcWrite(u32 sector);
@@ -4,6 +4,8 @@
 
 #include "pff.h"
 #include "diskio.h"
+#include "mmc.h"
+#include "spi.h"
 
 //#include "printf.h"
 
@@ -31,8 +33,10 @@ extern u32 n_actual_mmc_sector;
 #define CMD1	(0x40+1)	/* SEND_OP_COND (MMC) */
 #define	ACMD41	(0xC0+41)	/* SEND_OP_COND (SDC) */
 #define CMD8	(0x40+8)	/* SEND_IF_COND */
+#define CMD12	(0x40+12)	/* STOP_TRANSMISSION */
 #define CMD16	(0x40+16)	/* SET_BLOCKLEN */
 #define CMD17	(0x40+17)	/* READ_SINGLE_BLOCK */
+#define CMD18	(0x40+18)	/* READ_MULTIPLE_BLOCK */
 #define CMD24	(0x40+24)	/* WRITE_BLOCK */
 #define CMD55	(0x40+55)	/* APP_CMD */
 #define CMD58	(0x40+58)	/* READ_OCR */
@@ -100,11 +104,13 @@ BYTE send_cmd (
 		if (res > 1) return res;
 	}
 
-	/* Select the card */
-	DESELECT();
-	spiTransferFF();
-	SELECT();
-	spiTransferFF();
+	/* Select the card, CMD12 is sent while a multi block read is running */
+	if (cmd != CMD12) {
+		DESELECT();
+		spiTransferFF();
+		SELECT();
+		spiTransferFF();
+	}
 
 	/* Send a command packet */
 	spiTransferByte(cmd);						/* Start + Command index */
@@ -117,6 +123,8 @@ BYTE send_cmd (
 	if (cmd == CMD8) n = 0x87;			/* Valid CRC for CMD8(0x1AA) */
 	spiTransferByte(n);
 
+	if (cmd == CMD12) spiTransferFF();	/* Skip a stuff byte when stop reading */
+
 	/* Receive a command response */
 	n = 10;								/* Wait for a valid response in timeout of 10 attempts */
 	do {
@@ -235,6 +243,55 @@ u08 mmcRead(u32 sector)
 
 
 
+/*-----------------------------------------------------------------------*/
+/* Read multiple sectors                                                 */
+/*-----------------------------------------------------------------------*/
+
+u08 mmcReadMultiple(u32 sector, u08 *buffer, u32 count)
+{
+	BYTE rc;
+	UINT bc;
+	int res = 0;
+
+	if (!(CardType & CT_BLOCK)) sector *= 512;	/* Convert to byte address if needed */
+
+	if (send_cmd(CMD18, sector) == 0) {		/* READ_MULTIPLE_BLOCK */
+		while (count && !res) {
+			bc = 40000;
+			do {						/* Wait for data packet */
+				rc = spiTransferFF();
+			} while (rc == 0xFF && --bc);
+
+			if (rc == 0xFE) {			/* A data packet arrived */
+				for (bc = 512; bc; bc--)
+					*buffer++ = spiTransferFF();
+				spiTransferFF();		/* Skip CRC */
+				spiTransferFF();
+				count--;
+			} else
+				res = 1;
+		}
+
+		/* STOP_TRANSMISSION, the card is busy until the running sector is done */
+		if (send_cmd(CMD12, 0) == 0) {
+			bc = 40000;
+			while (spiTransferFF() != 0xFF && --bc);
+			if (!bc) res = 1;
+		} else
+			res = 1;
+	}
+	else
+	{
+		res = 1;
+	}
+
+	DESELECT();
+	spiTransferFF();
+	return res;
+}
+
+
+
 /*-----------------------------------------------------------------------*/
 /* Write partial sector                                                  */
 /*-----------------------------------------------------------------------*/
@@ -75,6 +75,7 @@ localparam RD_STATE_WAIT_IO    = 2'd1;
 localparam RD_STATE_SEND_TOKEN = 2'd2;
 localparam RD_STATE_SEND_DATA  = 2'd3;
 reg [1:0] read_state = RD_STATE_IDLE;  
+reg [1:0] rd_crc_cnt;   // crc bytes still to send between the sectors of a CMD18
 
 localparam WR_STATE_IDLE       = 3'd0;
 localparam WR_STATE_EXP_DTOKEN = 3'd1;
@@ -93,7 +94,8 @@ reg [2:0] bit_cnt;           // counts bits 0-7 0-7 ...
 reg [3:0] byte_cnt= 4'd15;   // counts bytes
 
 reg [31:0] lba;
-assign io_lba = io_sdhc?lba:{9'd0, lba[31:9]};
+reg [31:0] rd_sector = 32'd0;   // sector offset within a multi block read
+assign io_lba = (io_sdhc?lba:{9'd0, lba[31:9]}) + ((cmd == 8'h52)?rd_sector:32'd0);
 
 reg [7:0] reply;
 reg [7:0] reply0, reply1, reply2, reply3;
@@ -102,7 +104,8 @@ reg [3:0] reply_len;
 // falling edge of io_ack signals that a sector to be read has been written into
 // the sector buffer by the io controller. This signal is kept set as long
 // as the read state machine is in the "wait for io controller" state (state 1)
-wire rd_wait_io = (read_state != RD_STATE_IDLE);
+// (a CMD18 clears it after each sector as the next one needs a new io_ack)
+wire rd_wait_io = (cmd == 8'h52)?(read_state == RD_STATE_WAIT_IO):(read_state != RD_STATE_IDLE);
 reg rd_io_ack_i = 1'b0;
 always @(negedge io_ack or negedge rd_wait_io) begin
 	if(!rd_wait_io) rd_io_ack_i <= 1'b0;
@@ -150,7 +153,9 @@ always @(posedge buffer_dout_strobe or posedge new_cmd_rcvd) begin
 	end else begin
 		buffer_dout <= buffer[buffer_rptr];
 		buffer_rptr <= buffer_rptr + 9'd1;
-		if(buffer_rptr == 511) buffer_read_sector_done <= 1'b1;
+		// cleared again by the first byte of the next sector of a CMD18
+		if(cmd == 8'h52) buffer_read_sector_done <= (buffer_rptr == 511);
+		else if(buffer_rptr == 511) buffer_read_sector_done <= 1'b1;
 		if(buffer_rptr == 15)  buffer_read_ciscid_done <= 1'b1;
 	end
 end
@@ -159,7 +164,7 @@ end
 reg [8:0] buffer_wptr;
 reg buffer_write_strobe;
 wire buffer_din_strobe = io_din_strobe || buffer_write_strobe;
-wire [7:0] buffer_din = (cmd == 8'h51)?io_din:{sbuf, sd_sdi};
+wire [7:0] buffer_din = ((cmd == 8'h51)||(cmd == 8'h52))?io_din:{sbuf, sd_sdi};
 
 always @(posedge buffer_din_strobe or posedge new_cmd_rcvd) begin
 	if(new_cmd_rcvd == 1)
@@ -217,6 +222,9 @@ always@(negedge sd_sck) begin
 		buffer_read_strobe <= 1'b0;
 		sd_sdo <= 1'b1;				// default: send 1's (busy/wait)
 		req_io_rd <= 1'b0;
+
+		// the sector offset of a multi block read starts with the command
+		if(new_cmd_rcvd) rd_sector <= 32'd0;
 		
 		if(byte_cnt == 5+NCR) begin
 			sd_sdo <= reply[~bit_cnt];
@@ -231,9 +239,11 @@ always@(negedge sd_sck) begin
 					read_state <= RD_STATE_SEND_TOKEN;      // jump directly to data transmission
 						
 				// CMD17: READ_SINGLE_BLOCK
-				if(cmd == 8'h51) begin
+				// CMD18: READ_MULTIPLE_BLOCK
+				if((cmd == 8'h51)||(cmd == 8'h52)) begin
 					read_state <= RD_STATE_WAIT_IO;         // start waiting for data from io controller
 					req_io_rd <= 1'b1;                      // trigger request to io controller
+					rd_crc_cnt <= 2'd0;
 				end
 			end
 		end
@@ -256,23 +266,42 @@ always@(negedge sd_sck) begin
 
 			// waiting for io controller to return data
 			RD_STATE_WAIT_IO: begin
-				if(rd_io_ack && (bit_cnt == 7)) 
-					read_state <= RD_STATE_SEND_TOKEN;
+				if(bit_cnt == 7) begin
+					// CMD18: send the crc of the previous sector first
+					if(rd_crc_cnt != 0)
+						rd_crc_cnt <= rd_crc_cnt - 2'd1;
+					else if(rd_io_ack) begin
+						// CMD12: the io controller is done, end the read
+						if(cmd == 8'h4c)
+							read_state <= RD_STATE_IDLE;
+						else
+							read_state <= RD_STATE_SEND_TOKEN;
+					end
+				end
+
+				// CMD12: busy after the reply until the io controller is done
+				if((cmd == 8'h4c) && (byte_cnt > 5+NCR))
+					sd_sdo <= 1'b0;
 			end
 
 			// send data token
 			RD_STATE_SEND_TOKEN: begin
-				sd_sdo <= READ_DATA_TOKEN[~bit_cnt];
+				// CMD12: STOP_TRANSMISSION
+				if(cmd == 8'h4c)
+					read_state <= RD_STATE_IDLE;
+				else begin
+					sd_sdo <= READ_DATA_TOKEN[~bit_cnt];
 	
-				if(bit_cnt == 7) begin
-					read_state <= RD_STATE_SEND_DATA;   // next: send data
-					buffer_read_strobe <= 1'b1;         // trigger read of first data byte
+					if(bit_cnt == 7) begin
+						read_state <= RD_STATE_SEND_DATA;   // next: send data
+						buffer_read_strobe <= 1'b1;         // trigger read of first data byte
+					end
 				end
 			end
 					
 			// send data
 			RD_STATE_SEND_DATA: begin
-				if(cmd == 8'h51) 							// CMD17: READ_SINGLE_BLOCK
+				if((cmd == 8'h51)||(cmd == 8'h52)) 	// CMD17/CMD18: READ_SINGLE/MULTIPLE_BLOCK
 					sd_sdo <= buffer_dout[~bit_cnt];
 				else if(cmd == 8'h49) 					// CMD9: SEND_CSD
 					sd_sdo <= csd_byte[~bit_cnt];
@@ -285,6 +314,18 @@ always@(negedge sd_sck) begin
 					// sent 512 sector data bytes?
 					if((cmd == 8'h51) && buffer_read_sector_done) // (buffer_rptr == 0))
 						read_state <= RD_STATE_IDLE;   // next: send crc. It's ignored so return to idle state
+
+					// CMD18 continues with the next sector until CMD12
+					else if((cmd == 8'h52) && buffer_read_sector_done) begin
+						read_state <= RD_STATE_WAIT_IO;
+						req_io_rd <= 1'b1;
+						rd_sector <= rd_sector + 32'd1;
+						rd_crc_cnt <= 2'd1;            // this and one more byte are crc
+					end
+
+					// CMD12: STOP_TRANSMISSION
+					else if(cmd == 8'h4c)
+						read_state <= RD_STATE_IDLE;
 						
 					// sent 16 cid/csd data bytes?
 					else if(((cmd == 8'h49)||(cmd == 8'h4a)) && buffer_read_ciscid_done) // && (buffer_rptr == 16))
@@ -339,9 +380,11 @@ always @(posedge sd_sck or posedge sd_cs) begin
 
 			// byte_cnt > 6 -> complete command received
 			// first byte of valid command is 01xxxxxx
-			// don't accept new commands once a write or read command has been accepted
+			// don't accept new commands once a write or read command has been accepted,
+			// except for the CMD12 that ends a CMD18
  			if((byte_cnt > 5) && (write_state == WR_STATE_IDLE) && 
-				(read_state == RD_STATE_IDLE)  && sbuf[6:5] == 2'b01) begin
+				((read_state == RD_STATE_IDLE) || ((cmd == 8'h52) && ({sbuf, sd_sdi} == 8'h4c))) &&
+				sbuf[6:5] == 2'b01) begin
 				byte_cnt <= 4'd0;			
 				cmd <= { sbuf, sd_sdi};
 				new_cmd_rcvd <= 1'b1;
@@ -389,6 +432,10 @@ always @(posedge sd_sck or posedge sd_cs) begin
 				else if(cmd == 8'h4a)
 					reply <= 8'h00;    // ok
 				
+				// CMD12: STOP_TRANSMISSION
+				else if(cmd == 8'h4c)
+					reply <= 8'h00;    // ok
+				
 				// CMD16: SET_BLOCKLEN
 				else if(cmd == 8'h50) begin
 				   // we only support a block size of 512
@@ -402,6 +449,10 @@ always @(posedge sd_sck or posedge sd_cs) begin
 				else if(cmd == 8'h51)
 					reply <= 8'h00;    // ok
 
+				// CMD18: READ_MULTIPLE_BLOCK
+				else if(cmd == 8'h52)
+					reply <= 8'h00;    // ok
+
 				// CMD24: WRITE_BLOCK
 				else if(cmd == 8'h58) begin
 					reply <= 8'h00;    // ok
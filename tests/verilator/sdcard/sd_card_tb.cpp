@@ -1,6 +1,13 @@
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
 #include "Vsd_card.h"
 #include "verilated.h"
-#include "verilated_vcd_c.h"
+#include "sim.h"
+#include "bus.h"
 
 #include "integer.h"
 extern "C"
@@ -10,6 +17,7 @@ extern "C"
   #include "simpledir.h"
   #include "simplefile.h"
   void hexdump(void *, uint16_t, uint16_t);
+  extern unsigned char mmc_sector_buffer[512];
 }
 
 void hexdump(void *data, uint16_t size, uint16_t offset) {
@@ -35,12 +43,80 @@ void hexdump(void *data, uint16_t size, uint16_t offset) {
 }
 
 Vsd_card* top = NULL;
-VerilatedVcdC* tfp = NULL;
-int evcnt = 0;
+spi_master_t spi;
+
+#define SPI_CLK  24000000.0
+
+// the io controller side changes its signals every 10ns
+#define IO_NS    10
 
 void dump() {
-  top->eval();
-  tfp->dump (evcnt++);
+  sim_wait_ns(IO_NS);
+}
+
+// card image, mapped once. CARD_IMG selects the file (card.img),
+// CARD_SIZE the card size in sectors (e.g. 16M), default is the file
+// size. With CARD_COW (default 1) writes go to a private copy of the
+// mapping and the file stays untouched. Sectors beyond the end of the
+// file read as zero
+u08 *card = NULL;
+u32 card_sectors = 0;
+
+// sd cards address at most 2^32 sectors
+u32 parse_size(const char *s) {
+  char *end;
+  unsigned long long v = strtoull(s, &end, 0);
+  if(*end == 'k' || *end == 'K') v <<= 10;
+  if(*end == 'm' || *end == 'M') v <<= 20;
+  if(*end == 'g' || *end == 'G') v <<= 30;
+  return (v > 0xffffffffull)?0xffffffffu:v;
+}
+
+void card_open() {
+  const char *name = getenv("CARD_IMG")?getenv("CARD_IMG"):"card.img";
+  int cow = getenv("CARD_COW")?atoi(getenv("CARD_COW")):1;
+  struct stat st;
+
+  int fd = open(name, cow?O_RDONLY:O_RDWR);
+  if(fd < 0 || fstat(fd, &st) < 0) { perror(name); exit(-1); }
+
+  card_sectors = st.st_size / 512;
+  if(getenv("CARD_SIZE")) card_sectors = parse_size(getenv("CARD_SIZE"));
+  if(!card_sectors) { fprintf(stderr, "%s: empty card\n", name); exit(-1); }
+  size_t size = (size_t)card_sectors * 512;
+  size_t fsize = ((size_t)st.st_size < size)?st.st_size:size;
+
+  if(cow) {
+    // anonymous memory for the whole card, the file is mapped over it
+    card = (u08*)mmap(NULL, size, PROT_READ|PROT_WRITE,
+		      MAP_PRIVATE|MAP_ANONYMOUS|MAP_NORESERVE, -1, 0);
+    if(card != MAP_FAILED && fsize &&
+       mmap(card, fsize, PROT_READ|PROT_WRITE,
+	    MAP_PRIVATE|MAP_FIXED|MAP_NORESERVE, fd, 0) == MAP_FAILED)
+      card = (u08*)MAP_FAILED;
+  } else {
+    // the file grows sparse if the card is bigger
+    if((size_t)st.st_size < size && ftruncate(fd, size) < 0) { perror(name); exit(-1); }
+    card = (u08*)mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+  }
+  if(card == MAP_FAILED) { perror("mmap"); exit(-1); }
+  close(fd);
+
+  printf("%s: %u sectors (%u MB)%s\n", name, card_sectors,
+	 card_sectors >> 11, cow?", copy on write":"");
+}
+
+u08 *card_sector(u32 lba) {
+  if(lba >= card_sectors) {
+    printf("access to sector %u beyond end of card\n", lba);
+    return NULL;
+  }
+  return card + (size_t)lba*512;
+}
+
+// cards above 2GB are reported as SDHC and use block addressing
+int card_sdhc() {
+  return card_sectors > 4*1024*1024;
 }
 
 void host_init() {
@@ -55,6 +131,9 @@ void host_init() {
   
   int i;
 
+  // config byte, bit 0 = io controller uses sdhc
+  cid_csd[32] = card_sdhc();
+
   for(i=0;i<0x21;i++) {
     //    printf("INIT(%x)\n", cid_csd[i]);
 
@@ -84,36 +163,47 @@ void mmcChipSelect(int select) {
   top->sd_cs = select?0:1;
 }
 
+// the io controller transfers io_rate bytes per spi byte
+int io_rate = 1;
+
 void check4io() {
   static int state = 0;
-  static u08 buffer[512];
+  static u08 *sector = NULL, dummy[512];
 
   // check for external request 
-  if(top->io_rd) {
-    if(!state) {
-      FILE *file = fopen("card.img", "rb");
-      if(!file) { perror(""); exit(-1); }
-      fseek(file, 512*top->io_lba, SEEK_SET);
-      fread(buffer, 1, 512, file);
-      fclose(file);
-
-      //      printf("SD RD %d\n", top->io_lba);
-      top->io_ack = 1;
-      dump();
-      state = 512;
-    }
+  if((top->io_rd || top->io_wr) && !state) {
+    sector = card_sector(top->io_lba);
+    if(!sector) sector = (u08*)memset(dummy, 0, 512);
+
+    //      printf("SD %s %d\n", top->io_rd?"RD":"WR", top->io_lba);
+    // io_ack clears the request
+    state = top->io_rd?512:-512;
+    top->io_ack = 1;
+    dump();
   }
 
-  if(state != 0) {
-    //    printf("tx[%d]=%x\n", 512-state, buffer[512-state]);
+  // IO_RATE bytes (default 1) per call in both directions
+  for(int n=0;n<io_rate && state;n++) {
+    if(state > 0) {
+      //    printf("tx[%d]=%x\n", 512-state, sector[512-state]);
 
-    top->io_din = buffer[512-state];
-    top->io_din_strobe = 1;
-    dump();
-    top->io_din_strobe = 0;
-    dump();
+      top->io_din = sector[512-state];
+      top->io_din_strobe = 1;
+      dump();
+      top->io_din_strobe = 0;
+      dump();
 
-    state--;
+      state--;
+    } else {
+      // io_dout is updated on the rising edge of the strobe
+      top->io_dout_strobe = 1;
+      dump();
+      sector[512+state] = top->io_dout;
+      top->io_dout_strobe = 0;
+      dump();
+
+      state++;
+    }
 
     if(state == 0) {
       //      printf("TX done\n");
@@ -124,28 +214,13 @@ void check4io() {
 }
 
 u08 spiTransferByte(u08 byte) {
-  int i;
-  u08 rval = 0;
+  u08 rval;
 
   //  printf("SPI(%x)=", byte);
 
   check4io();
 
-  dump();
-
-  for(i=0;i<8;i++) {
-    top->sd_sdi = (byte & 0x80)?1:0;
-
-    dump();
-    top->sd_sck = 1;
-    dump();
-    top->sd_sck = 0;
-  
-    rval = (rval << 1)|(top->sd_sdo?1:0);
-
-    byte <<= 1;
-  }
-  dump();
+  rval = spi.transfer(byte);
 
   //  printf("%x\n", rval);
 
@@ -160,13 +235,81 @@ void spiTx1(int i) {
   while(i--) {
     top->sd_sdi = 1;
 
-    dump();
+    sim_wait_ns(2*spi.quarter_ns);
     top->sd_sck = 1;
-    dump();
+    sim_wait_ns(spi.quarter_ns);
     top->sd_sck = 0;
-    dump();
+    sim_wait_ns(spi.quarter_ns);
   }
-  dump();
+}
+
+// ------------------------- streaming benchmark -----------------------------
+
+// the io controller handshake is watched after every evaluation
+unsigned long io_reqs, io_strobes;
+sim_time_t io_start, io_time;
+int last_io_rd, last_io_ack, last_io_strobe;
+
+void io_watch(void) {
+  if(top->io_rd && !last_io_rd) {
+    io_reqs++;
+    io_start = sim_time;
+  }
+  if(!top->io_ack && last_io_ack && io_start) {
+    io_time += sim_time - io_start;
+    io_start = 0;
+  }
+  if(top->io_din_strobe && !last_io_strobe) io_strobes++;
+
+  last_io_rd = top->io_rd;
+  last_io_ack = top->io_ack;
+  last_io_strobe = top->io_din_strobe;
+}
+
+// read count sectors from first on with one CMD17 per sector or with
+// CMD18 multi block reads and compare them with the card image. The SPI line rate is one
+// byte per 8 SPI clocks
+u08 stream_buffer[64*512];
+
+int stream(const char *name, u32 first, u32 count, int multi) {
+  unsigned long errors = 0;
+  u32 i, n;
+
+  io_reqs = io_strobes = io_time = 0;
+  io_start = 0;
+  last_io_rd = top->io_rd;
+  last_io_ack = top->io_ack;
+  last_io_strobe = top->io_din_strobe;
+  sim_eval_hook = io_watch;
+
+  unsigned long bytes = spi.bytes;
+  sim_time_t start = sim_time;
+
+  // CMD18 reads chunks of up to 64 sectors
+  for(i=0;i<count;i+=n) {
+    n = multi?((count-i > 64)?64:count-i):1;
+    u08 *buf = multi?stream_buffer:mmc_sector_buffer;
+    if(multi?mmcReadMultiple(first+i, buf, n):mmcRead(first+i)) {
+      printf("ERROR: %s read of sector %u failed\n", name, first+i);
+      errors++;
+      break;
+    }
+    for(u32 j=0;j<n;j++)
+      if(memcmp(buf+512*j, card_sector(first+i+j), 512) && errors++ < 10)
+	printf("ERROR: %s sector %u differs\n", name, first+i+j);
+  }
+
+  sim_eval_hook = NULL;
+  bytes = spi.bytes - bytes;
+  double secs = (sim_time - start)/1e12;
+
+  printf("%-6s %7u %9.1f %9.3f %6.1f%% %8.0f %7lu %8.1f %8.2f %lu\n", name, count,
+	 (double)bytes/count, 512.0*count/(8.0*bytes), 100.0*512*count/bytes,
+	 512.0*count/secs/1024, io_reqs, (double)io_strobes/count,
+	 io_time/1e6/count, errors);
+  fflush(stdout);
+
+  return errors != 0;
 }
 
 #define DIR_INIT_MEMSIZE 16*1024
@@ -175,17 +318,15 @@ char ROM_DIR[]="/atari800/rom";
 
 int main(int argc, char **argv, char **env) {
   struct SimpleFile *file;
-  int i;
+  int i, failed = 0;
   int clk;
   Verilated::commandArgs(argc, argv);
   // init top verilog instance
   top = new Vsd_card;
+  sim_init(top);
 
-  // init trace dump
-  Verilated::traceEverOn(true);
-  tfp = new VerilatedVcdC;
-  top->trace (tfp, 1000);
-  tfp->open ("sd_card.vcd");
+  // init trace dump, see trace.h
+  trace_init(top, "sd_card", 1000);
  
   // initialize simulation inputs
   top->io_ack = 0;
@@ -195,8 +336,11 @@ int main(int argc, char **argv, char **env) {
   top->allow_sdhc = 1;
 
   top->sd_cs = 1;
-  top->sd_sck = 0;
   top->sd_sdi = 1;
+  spi.init(&top->sd_sck, &top->sd_sdi, &top->sd_sdo, SPI_CLK, 0);
+
+  card_open();
+  if(getenv("IO_RATE")) io_rate = atoi(getenv("IO_RATE"));
 
   file = (struct SimpleFile *)alloca(file_struct_size());
   file_init(file);
@@ -219,15 +363,45 @@ int main(int argc, char **argv, char **env) {
 
       printf("read total of %d bytes\n", total);
 
-    } else
+    } else {
       printf("atarixl.rom not found\n");
-  } else
+      failed = 1;
+    }
+  } else {
     printf("dir init failed\n");
+    failed = 1;
+  }
+
+  // write a pattern to the last sector and read it back
+  u32 last = card_sectors-1;
+  for(i=0;i<512;i++) mmc_sector_buffer[i] = i ^ last;
+  mmcWrite(last);
+  int ok = !memcmp(mmc_sector_buffer, card_sector(last), 512);
+  memset(mmc_sector_buffer, 0, 512);
+  mmcRead(last);
+  for(i=0;i<512 && mmc_sector_buffer[i] == (u08)(i ^ last);i++);
+  printf("write/read of sector %u %s\n", last, (ok && i == 512)?"ok":"failed");
+  if(!ok || i != 512) failed = 1;
+
+  // stream STREAM sectors (default 256) from STREAM_LBA (default 0) on
+  u32 first = getenv("STREAM_LBA")?parse_size(getenv("STREAM_LBA")):0;
+  u32 count = getenv("STREAM")?parse_size(getenv("STREAM")):256;
+  if(first >= card_sectors) first = 0;
+  if(count > card_sectors - first) count = card_sectors - first;
+  if(count) {
+    printf("%-6s %7s %9s %9s %7s %8s %7s %8s %8s %s\n", "read", "sectors",
+	   "spi/sect", "byte/clk", "line", "kB/s", "io reqs", "strobes", "io us", "errors");
+    failed |= stream("single", first, count, 0);
+    failed |= stream("multi", first, count, 1);
+  }
 
-  tfp->close();
+  // the trace ring is only written if something went wrong
+  if(failed) trace_fail();
+  else       trace_close();
 
   printf("MMC access done\n");
+  sim_report();
 
-  exit(0);
+  exit(failed);
 }
 
@@ -0,0 +1,82 @@
+// ste_snd.v
+//
+// Test wrapper for the STE dma sound of the MiST
+// (../../../cores/mist/ste_dma_snd.v). The 8MHz clock and the bus cycle
+// are derived from the 32MHz clock like in mist_top.v and the cpu
+// interface uses the signal names of ../common/bus.h. The fifo state is
+// brought out for the testbench.
+//
+
+module ste_snd (
+      input 	    clk_32,
+      input 	    reset,
+      output 	    clk_8,
+      output reg [1:0] bus_cycle,
+
+      // cpu register interface
+      input 	    cpu_sel,
+      input [4:0]   cpu_addr,
+      input [15:0]  cpu_din,
+      output [15:0] cpu_dout,
+      input 	    cpu_uds,
+      input 	    cpu_lds,
+      input 	    cpu_rw,
+
+      // memory interface
+      input 	    hsync,
+      output 	    read,
+      output [22:0] saddr,
+      input [63:0]  data,
+
+      output [7:0]  audio_l,
+      output [7:0]  audio_r,
+      output 	    xsint,
+
+      // internal state
+      output [2:0]  fifo_level,
+      output [11:0] fifo_underflow,
+      output 	    dma_enable
+);
+
+// 8MHz clock and bus cycle like in mist_top.v
+reg [1:0] clk_cnt = 2'd2;
+initial bus_cycle = 2'd0;
+
+always @(posedge clk_32) begin
+	clk_cnt <= clk_cnt + 2'd1;
+	if(clk_cnt == 2'd1)
+		bus_cycle <= bus_cycle + 2'd1;
+end
+
+assign clk_8 = clk_cnt[1];
+
+assign fifo_level = ste_dma_snd.writeP - ste_dma_snd.readP;
+assign fifo_underflow = ste_dma_snd.fifo_underflow;
+assign dma_enable = ste_dma_snd.dma_enable;
+
+ste_dma_snd ste_dma_snd (
+	.clk       ( clk_8     ),
+	.reset     ( reset     ),
+	.din       ( cpu_din   ),
+	.sel       ( cpu_sel   ),
+	.addr      ( cpu_addr  ),
+	.uds       ( cpu_uds   ),
+	.lds       ( cpu_lds   ),
+	.rw        ( cpu_rw    ),
+	.dout      ( cpu_dout  ),
+
+	.clk32     ( clk_32    ),
+	.bus_cycle ( bus_cycle ),
+	.hsync     ( hsync     ),
+	.read      ( read      ),
+	.saddr     ( saddr     ),
+	.data      ( data      ),
+
+	.audio_l   ( audio_l   ),
+	.audio_r   ( audio_r   ),
+
+	.xsint     ( xsint     ),
+	.xsint_d   (           )
+);
+
+endmodule
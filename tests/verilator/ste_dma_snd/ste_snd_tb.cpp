@@ -0,0 +1,278 @@
+// ste_snd_tb.cpp
+//
+// Plays a looping frame through the STE dma sound at every sample rate
+// in mono and stereo, next to the hsync of the pal, ntsc and mono video
+// modes. The frame is a ramp, so every played sample can be checked.
+// Per run the bus slots used per scanline, the lowest fifo fill level
+// and the fifo underruns are reported. WAV=prefix also writes the
+// audio output of each run to prefix_<video>_<rate>_<channels>.wav
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Vste_snd.h"
+#include "verilated.h"
+#include "sim.h"
+#include "bus.h"
+
+#define CLK        (32000000.0)
+#define BASE       (50066.0)       // sample rate base of ste_dma_snd.v
+
+#define FRAME      0x10000         // the looped frame in ram
+#define FRAME_LEN  4096            // bytes, a multiple of the ramp length
+
+Vste_snd* top = NULL;
+ram_t ram;
+st_bus_t<Vste_snd> bus;
+
+// line timing of the shifter in 32MHz clocks, see video_modes.v
+typedef struct {
+  const char *name;
+  int line, sync;
+} video_t;
+
+const video_t videos[] = {
+  { "pal",  2048, 128 },     // 1024 pixels at 16MHz, 64 pixels sync
+  { "ntsc", 2032, 128 },     // 1016 pixels at 16MHz, 64 pixels sync
+  { "mono",  896,  40 },     //  896 pixels at 32MHz, 40 pixels sync
+  { NULL }
+};
+
+const video_t *video;
+int line_pos, last_clk_8;
+
+// statistics of one run, taken while measuring is set
+int measuring;
+unsigned long lines, slots, slots_max, slots_avail;
+unsigned long samples, underruns, errors;
+unsigned long line_slots, line_avail;
+int fifo_min;
+int last_l, last_r, have_sample, last_underflow;
+int mono;
+
+FILE *wav;
+unsigned long wav_samples;
+
+// a new sample continues the ramps, left up and right down in stereo
+void check_sample(void) {
+  if(have_sample) {
+    int exp_l = (last_l + 1) & 0xff;
+    int exp_r = mono?exp_l:((last_r - 1) & 0xff);
+    if(top->audio_l != exp_l || top->audio_r != exp_r) {
+      if(errors++ < 10)
+	printf("ERROR: sample %02x/%02x, expected %02x/%02x\n",
+	       top->audio_l, top->audio_r, exp_l, exp_r);
+      if(errors == 1) trace_fail();
+    }
+    samples++;
+  }
+  have_sample = 1;
+  last_l = top->audio_l;
+  last_r = top->audio_r;
+}
+
+// the end of a hsync pulse ends the scanline statistics
+void line_done(void) {
+  if(measuring) {
+    lines++;
+    slots += line_slots;
+    if(line_slots > slots_max) slots_max = line_slots;
+    slots_avail += line_avail;
+  }
+  line_slots = line_avail = 0;
+}
+
+// everything changes after the rising 32MHz edge, the 8MHz clock and the
+// bus cycle are derived from it in the model
+int clk_32_edge(int level) {
+  if(!level) return 0;
+
+  if(top->clk_8 != last_clk_8) {
+    last_clk_8 = top->clk_8;
+    if(top->clk_8)
+      bus.posedge();
+    else {
+      bus.negedge();
+
+      // the video cycle in hsync belongs to the dma sound
+      if(top->bus_cycle == 0 && top->hsync) {
+	line_avail++;
+	if(top->read) line_slots++;
+      }
+    }
+  }
+
+  // the ram delivers the 64 bits of the current address
+  top->data = ram.read64((top->saddr << 1) & ~7);
+
+  if(++line_pos == video->line) line_pos = 0;
+  if(top->hsync && line_pos == video->sync) line_done();
+  top->hsync = line_pos < video->sync;
+
+  if(top->audio_l != last_l || top->audio_r != last_r)
+    check_sample();
+
+  // the 12 bit underflow counter of the model
+  if(top->fifo_underflow != last_underflow) {
+    if(measuring) underruns += (top->fifo_underflow - last_underflow) & 0xfff;
+    last_underflow = top->fifo_underflow;
+  }
+
+  // measure from the first fetch on, the fill level from the first
+  // complete scanline on
+  if(!measuring && top->dma_enable && top->fifo_level) {
+    measuring = 1;
+    fifo_min = 7;
+  }
+  if(lines && top->fifo_level < fifo_min)
+    fifo_min = top->fifo_level;
+
+  return 1;
+}
+
+// ------------------------------ wav output ----------------------------------
+
+static void put_le(FILE *f, uint32_t v, int bytes) {
+  while(bytes--) { fputc(v & 0xff, f); v >>= 8; }
+}
+
+static void wav_header(FILE *f, int channels, int rate, uint32_t len) {
+  fwrite("RIFF", 1, 4, f); put_le(f, 36 + len, 4);
+  fwrite("WAVEfmt ", 1, 8, f); put_le(f, 16, 4);
+  put_le(f, 1, 2);                      // pcm
+  put_le(f, channels, 2);
+  put_le(f, rate, 4);
+  put_le(f, rate * channels, 4);        // bytes per second
+  put_le(f, channels, 2);               // block align
+  put_le(f, 8, 2);                      // 8 bit unsigned
+  fwrite("data", 1, 4, f); put_le(f, len, 4);
+}
+
+// a timer at the sample rate
+int wav_edge(int level) {
+  if(!level || !wav) return 0;
+  fputc(top->audio_l, wav);
+  if(!mono) fputc(top->audio_r, wav);
+  wav_samples++;
+  return 0;
+}
+
+void wav_open(int rate) {
+  char name[256];
+
+  wav_samples = 0;
+  wav = NULL;
+  if(!getenv("WAV")) return;
+
+  snprintf(name, sizeof(name), "%s_%s_%d_%s.wav", getenv("WAV"),
+	   video->name, rate, mono?"mono":"stereo");
+  if(!(wav = fopen(name, "wb"))) {
+    perror(name);
+    return;
+  }
+  wav_header(wav, mono?1:2, rate, 0);
+}
+
+void wav_close(int rate) {
+  if(!wav) return;
+  rewind(wav);
+  wav_header(wav, mono?1:2, rate, wav_samples * (mono?1:2));
+  fclose(wav);
+  wav = NULL;
+}
+
+// --------------------------------- runs -------------------------------------
+
+// frame start and end go to bytes 23:16, 15:8 and 7:1 of three registers
+void set_address(uint32_t reg, uint32_t addr) {
+  bus.write(reg,   (addr >> 16) & 0xff);
+  bus.write(reg+2, (addr >> 8) & 0xff);
+  bus.write(reg+4, addr & 0xfe);
+}
+
+// play the frame in a loop for ms milliseconds
+int run(const video_t *v, int rate_sel, int m, double ms) {
+  int rate = BASE / (1 << (3-rate_sel)) + 0.5;
+
+  video = v;
+  mono = m;
+  measuring = 0;
+  lines = slots = slots_max = slots_avail = 0;
+  samples = underruns = errors = 0;
+  line_slots = line_avail = have_sample = 0;
+  line_pos = 0;
+
+  sim_remove_clocks();
+  sim_add_clock(&top->clk_32, CLK, NULL, clk_32_edge);
+
+  // the fifo read side is reset by the audio clock of the previous mode
+  top->reset = 1;
+  sim_wait_us(400);
+  top->reset = 0;
+
+  set_address(0xff8902, FRAME);
+  set_address(0xff890e, FRAME + FRAME_LEN);
+  bus.write(0xff8920, (mono?0x80:0x00) | rate_sel);
+
+  wav_open(rate);
+  sim_add_clock(NULL, rate, NULL, wav_edge);
+
+  bus.write(0xff8900, 3);                // play and loop
+  sim_wait_ms(ms);
+  bus.write(0xff8900, 0);
+  wav_close(rate);
+
+  printf("%-5s %6d %-6s %6lu %7.2f %5lu %6.2f %5d %6lu %9lu %lu\n",
+	 v->name, rate, mono?"mono":"stereo", lines,
+	 lines?(double)slots/lines:0.0, slots_max,
+	 lines?(double)slots_avail/lines:0.0, fifo_min,
+	 samples, underruns, errors);
+  fflush(stdout);
+
+  return underruns || errors || !samples;
+}
+
+int main(int argc, char **argv, char **env) {
+  Verilated::commandArgs(argc, argv);
+  // init top verilog instance
+  top = new Vste_snd;
+  sim_init(top);
+
+  // init trace dump, see trace.h
+  trace_init(top, "ste_snd");
+
+  double ms = getenv("MS")?atof(getenv("MS")):20;
+
+  ram.init(0, 0x20000);
+  bus.init(top, 0xff8900, ~0x3f);
+  top->clk_32 = 0;
+  top->hsync = 0;
+
+  printf("%lu ms per run, %d byte frame\n", (unsigned long)ms, FRAME_LEN);
+  printf("%-5s %6s %-6s %6s %7s %5s %6s %5s %6s %9s %s\n", "video",
+	 "rate", "chan", "lines", "slots", "max", "avail", "fifo",
+	 "samples", "underruns", "errors");
+
+  int failed = 0;
+  for(const video_t *v = videos; v->name; v++) {
+    if(getenv("VIDEO") && strcmp(getenv("VIDEO"), v->name)) continue;
+    for(int m=0;m<2;m++) {
+      // the frame holds a byte ramp in mono, a rising left and a
+      // falling right ramp in stereo
+      for(int i=0;i<FRAME_LEN/2;i++) {
+	unsigned char *p = ram.ptr(FRAME + 2*i, 2);
+	if(m) { p[0] = 2*i; p[1] = 2*i+1; }
+	else  { p[0] = i;   p[1] = -i; }
+      }
+      for(int r=3;r>=0;r--) {
+	if(getenv("RATE") && atoi(getenv("RATE")) != r) continue;
+	failed |= run(v, r, m, ms);
+      }
+    }
+  }
+
+  sim_report();
+  trace_close();
+  return failed;
+}
@@ -0,0 +1,71 @@
+#!/bin/bash
+# run all video modes in parallel and compare the measured sync timings
+# with the expected ones. Usage: ./matrix.sh [jobs]
+# The logs are kept in matrix/<mode>.log. With HASHES set the frame
+# hashes are checked as well, a mode whose testbench fails is failed
+
+BIN=${BIN:-obj_dir/Vvideo}
+JOBS=${1:-$(nproc)}
+DIR=matrix
+TOL=0.5   # percent
+
+if [ ! -x $BIN ]; then
+    echo "Please build $BIN first, e.g. make HEADLESS=1 obj_dir/Vvideo"
+    exit 1
+fi
+
+# name, options, expected hsync kHz and vsync Hz at the simulated 31.875MHz.
+# The ST line has 1024 (PAL50), 928 (PAL56) or 1016 (NTSC) pixels at
+# 16MHz, hires 896 at 32MHz and viking 1728 at 128MHz. PAL56 is only
+# used together with the scan doubler
+MODES="
+low_pal50     REZ=0,SD=0,PAL=1,PAL56=0  15.564  49.725
+low_pal50_sd  REZ=0,SD=1,PAL=1,PAL56=0  31.128  49.725
+low_pal56     REZ=0,SD=0,PAL=1,PAL56=1  15.564  49.725
+low_pal56_sd  REZ=0,SD=1,PAL=1,PAL56=1  34.348  56.124
+low_ntsc      REZ=0,SD=0,PAL=0          15.687  59.645
+low_ntsc_sd   REZ=0,SD=1,PAL=0          31.373  59.645
+mid_pal50     REZ=1,SD=0,PAL=1,PAL56=0  15.564  49.725
+mid_pal50_sd  REZ=1,SD=1,PAL=1,PAL56=0  31.128  49.725
+mid_pal56     REZ=1,SD=0,PAL=1,PAL56=1  15.564  49.725
+mid_pal56_sd  REZ=1,SD=1,PAL=1,PAL56=1  34.348  56.124
+mid_ntsc      REZ=1,SD=0,PAL=0          15.687  59.645
+mid_ntsc_sd   REZ=1,SD=1,PAL=0          31.373  59.645
+hi            REZ=2                     35.575  71.008
+viking        VIKING=1                  73.785  70.540
+"
+
+mkdir -p $DIR
+START=$SECONDS
+
+while read NAME OPTS HS VS; do
+    [ -z "$NAME" ] && continue
+    while [ $(jobs -r | wc -l) -ge $JOBS ]; do wait -n; done
+    ( $BIN ${OPTS//,/ } < /dev/null; echo "EXIT $?" ) > $DIR/$NAME.log 2>&1 &
+done <<< "$MODES"
+wait
+
+echo "all modes simulated in $((SECONDS-START))s"
+echo
+printf "%-14s %10s %10s  %10s %10s  %s\n" mode "hsync kHz" expected "vsync Hz" expected result
+FAILED=0
+
+# the last reported timing is the one the mode settled to
+while read NAME OPTS HS VS; do
+    [ -z "$NAME" ] && continue
+    MHS=$(grep "^HSYNC" $DIR/$NAME.log | tail -1 | sed 's/.* \([0-9.]*\)khz$/\1/')
+    MVS=$(grep "^VSYNC" $DIR/$NAME.log | tail -1 | sed 's/.* \([0-9.]*\)hz$/\1/')
+    EXIT=$(grep "^EXIT" $DIR/$NAME.log | tail -1 | cut -d' ' -f2)
+    RESULT=$(awk -v m1="$MHS" -v e1=$HS -v m2="$MVS" -v e2=$VS -v t=$TOL -v x="$EXIT" 'BEGIN {
+        if(x != "0") { print "FAIL exit " x; exit }
+        if(m1 == "" || m2 == "") { print "no sync"; exit }
+        d1 = 100*(m1-e1)/e1; d2 = 100*(m2-e2)/e2;
+        if(d1 < -t || d1 > t || d2 < -t || d2 > t) printf("FAIL %+.2f%% %+.2f%%\n", d1, d2);
+        else print "ok" }')
+    [ "$RESULT" != "ok" ] && FAILED=$((FAILED+1))
+    printf "%-14s %10s %10s  %10s %10s  %s\n" $NAME "${MHS:--}" $HS "${MVS:--}" $VS "$RESULT"
+done <<< "$MODES"
+
+echo
+echo "$FAILED modes failed"
+exit $((FAILED>0))
@@ -0,0 +1,40 @@
+; 68000 code for the co-simulation in video_tb.cpp. Re-programs the
+; current video mode like a mode switch in TOS does and then changes
+; the border color at the begin of the next three frames, which are
+; found by polling the video address counter. Returns the number of
+; polls in d7
+
+vcnthi	 equ	$ff8205
+vcntmid	 equ	$ff8207
+vcntlo	 equ	$ff8209
+syncmode equ	$ff820a
+color0	 equ	$ff8240
+shiftmd	 equ	$ff8260
+
+	org	$100000
+
+start:	move.b	syncmode,d0
+	move.b	shiftmd,d1
+	move.b	d0,syncmode
+	move.b	d1,shiftmd
+
+	moveq	#0,d7
+	moveq	#2,d6		; frames
+	moveq	#0,d5		; last counter value
+	move.w	#$700,d4	; red, green, blue
+poll:	addq.l	#1,d7
+	moveq	#0,d0
+	move.b	vcnthi,d0
+	lsl.l	#8,d0
+	move.b	vcntmid,d0
+	lsl.l	#8,d0
+	move.b	vcntlo,d0
+	cmp.l	d5,d0
+	exg	d0,d5		; keeps the flags
+	bcc.s	poll		; counter still increasing
+
+	move.w	d4,color0
+	lsr.w	#4,d4
+	dbra	d6,poll
+
+	stop	#$2700
@@ -1,8 +1,16 @@
+#ifndef HEADLESS
 #include <SDL.h>
+#else
+typedef unsigned int Uint32;
+#endif
 
 #include "Vvideo.h"
 #include "verilated.h"
-#include "verilated_vcd_c.h"
+#include "sim.h"
+#include "bus.h"
+#ifdef MUSASHI
+#include "cpu68k.h"
+#endif
 
 // analyze video mode and compare with:
 // http://alive.atari.org/alive9/ovrscn1.php
@@ -17,48 +25,47 @@
 // - OSD right border
 // - check STE sound
 
-#define DUMP 1
-#define VIKING 0 // enable viking card
-#define REZ 0    // LOW=0, MID=1, HI=2
-#define SD 1     // scan doubler on/off
-#define SL 2     // scanlines 0=off -> 3=75%
-#define PAL 1    // 0-NTSC or 1-PAL
-#define PAL56 0  // enable PAL56 mode
-
-#define STE_SHIFT       0  // 1
-#define STE_LINE_OFFSET 0
+// the video mode is selected at runtime by NAME=value arguments, e.g.
+//   obj_dir/Vvideo REZ=1 SD=0 PAL=0
+int VIKING = 0;          // enable viking card
+int REZ = 0;             // LOW=0, MID=1, HI=2
+int SD = 1;              // scan doubler on/off
+int SL = 2;              // scanlines 0=off -> 3=75%
+int PAL = 1;             // 0-NTSC or 1-PAL
+int PAL56 = 0;           // enable PAL56 mode
+int STE_SHIFT = 0;       // 1
+int STE_LINE_OFFSET = 0;
+
+struct { const char *name; int *val; } options[] = {
+  { "VIKING", &VIKING }, { "REZ", &REZ }, { "SD", &SD }, { "SL", &SL },
+  { "PAL", &PAL }, { "PAL56", &PAL56 }, { "STE_SHIFT", &STE_SHIFT },
+  { "STE_LINE_OFFSET", &STE_LINE_OFFSET }, { NULL, NULL } };
 
 #define CLK        (31875000.0)
 
-#if VIKING
-#define W 900
-#define H 540
-#else
-#if REZ==0 && SD==0
-#define W 513
-#else
-#define W 1026
-#endif
+// framebuffer size, depends on the mode
+int W, H;
 
-#if REZ==2 || SD==1
-#define H 626
-#else
-#define H 313
-#endif
-#endif
-
-unsigned char vidmem[1280*1024/8]; 
+#define VIDMEM_SIZE (1280*1024/8)
+unsigned char *vidmem;
+ram_t ram;
 
+#ifndef HEADLESS
 SDL_Surface* screen = NULL;
-
-Vvideo* top = NULL;
-#if DUMP
-VerilatedVcdC* tfp = NULL;
 #endif
 
-double time_ns = 0;
+// the image is rendered into fb and shown once per frame. Each
+// completed frame is hashed. Environment:
+//   FRAMES=prefix  write every completed frame to prefix<n>.ppm
+//   HASHES=file    compare the frame hashes with the ones in file,
+//                  missing ones are errors
+//   RECORD=1       add missing hashes to the HASHES file instead
+Uint32 *fb;
+int frame = 0;
+int frame_errors = 0;
+
+Vvideo* top = NULL;
 
-#define MHZ2NS(a)  (1000000000.0/(a))
 
 void hexdump(void *data, int size) {
   int i, b2c, n=0;
@@ -81,35 +88,115 @@ void hexdump(void *data, int size) {
 }
 
 void put_pixel32(int x, int y, Uint32 pixel ) {
-  // Convert the pixels to 32 bit 
-  Uint32 *pixels = (Uint32 *)screen->pixels; 
   // Set the pixel 
-#if VIKING
-  // average half size
-  if((x < 2*W) && (y < 2*H)) {
-    pixel = (pixel>>2)&0x3f3f3f;
-    if(!(y&1) && !(x&1)) 
-      pixels[ ( y/2 * screen->w ) + x/2 ] = pixel;
-    else
-      pixels[ ( y/2 * screen->w ) + x/2 ] += pixel;
-  }
-#else
-  if((x < W) && (y < H))
-    pixels[ ( y * screen->w ) + x ] = pixel; 
-#endif
+  if(VIKING) {
+    // average half size
+    if((x < 2*W) && (y < 2*H)) {
+      pixel = (pixel>>2)&0x3f3f3f;
+      if(!(y&1) && !(x&1)) 
+	fb[ ( y/2 * W ) + x/2 ] = pixel;
+      else
+	fb[ ( y/2 * W ) + x/2 ] += pixel;
+    }
+  } else if((x < W) && (y < H))
+    fb[ ( y * W ) + x ] = pixel; 
 } 
 
-int dump_enabled = 0;
+// mode name used in the hash file
+const char *mode_name(void) {
+  static char str[64];
+  sprintf(str, "rez%d_sd%d_sl%d_pal%d_pal56%d_viking%d_ste%d",
+	  REZ, SD, SL, PAL, PAL56, VIKING, STE_SHIFT);
+  return str;
+}
 
-void eval(void) {
-  // evaluate recent changes
-  top->eval();
+void write_ppm(const char *name) {
+  FILE *f = fopen(name, "wb");
+  int i;
+
+  if(!f) { perror(name); return; }
+  fprintf(f, "P6\n%d %d\n255\n", W, H);
+  for(i=0;i<W*H;i++) {
+    unsigned char rgb[3] = { (unsigned char)(fb[i]>>16), (unsigned char)(fb[i]>>8), (unsigned char)fb[i] };
+    fwrite(rgb, 1, 3, f);
+  }
+  fclose(f);
+}
+
+// look up the hash of a frame. Unknown ones are errors unless RECORD is set
+void check_hash(const char *name, int n, unsigned long long hash) {
+  char line[128], mode[64];
+  unsigned long long h;
+  int fn;
+
+  FILE *f = fopen(name, "r");
+  if(f) {
+    while(fgets(line, sizeof(line), f))
+      if(sscanf(line, "%63s %d %llx", mode, &fn, &h) == 3 &&
+	 !strcmp(mode, mode_name()) && fn == n) {
+	fclose(f);
+	if(h != hash) {
+	  printf("frame %d: hash %016llx, expected %016llx\n", n, hash, h);
+	  frame_errors++;
+	}
+	return;
+      }
+    fclose(f);
+  }
+
+  if(!getenv("RECORD")) {
+    printf("frame %d: hash %016llx, none recorded for %s\n", n, hash, mode_name());
+    frame_errors++;
+    return;
+  }
 
-#if DUMP
-  if(dump_enabled)
-    tfp->dump(time_ns);
+  f = fopen(name, "a");
+  if(!f) { perror(name); return; }
+  fprintf(f, "%s %d %016llx\n", mode_name(), n, hash);
+  fclose(f);
+}
+
+// a new frame begins. The first one is incomplete as rendering starts
+// somewhere in the middle
+void frame_done(void) {
+  if(frame) {
+    // fnv-1a over the pixels
+    unsigned long long hash = 0xcbf29ce484222325ull;
+    unsigned char *p = (unsigned char*)fb;
+    int i;
+    for(i=0;i<4*W*H;i++)
+      hash = (hash ^ p[i]) * 0x100000001b3ull;
+
+    printf("frame %d hash %016llx\n", frame, hash);
+
+    if(getenv("HASHES")) check_hash(getenv("HASHES"), frame, hash);
+
+    if(getenv("FRAMES")) {
+      char name[256];
+      snprintf(name, sizeof(name), "%s%d.ppm", getenv("FRAMES"), frame);
+      write_ppm(name);
+    }
+  }
+
+#ifndef HEADLESS
+  /* update the screen */
+  { int y;
+    for(y=0;y<H;y++)
+      memcpy((char*)screen->pixels + y*screen->pitch, fb + y*W, 4*W);
+    SDL_UpdateRect(screen, 0, 0, 0, 0);
+  }
 #endif
 
+  memset(fb, 0, 4*W*H);
+  frame++;
+}
+
+int dump_enabled = 0;
+
+// watch the outputs after every evaluation
+void video_eval(void) {
+  double time_ns = sim_time/1000.0;
+
   // check if hsync changes
   { static int hs = 0;
     static double hs_ns = 0;
@@ -176,16 +263,8 @@ void eval(void) {
   { static int last_cpu_clk = 0;
     if(!top->cpu_clk && last_cpu_clk) {
       if(top->read) {
-	unsigned long long v;
-#if VIKING
 	// viking can address up to 256kb
-	memcpy(&v, vidmem+2*(top->vaddr&0x1fffc), 8);
-#else
-	memcpy(&v, vidmem+2*(top->vaddr&0x7ffc), 8);
-#endif 
-	top->data =
-	  ((v & 0xff00ff00ff00ff00) >> 8) |
-	  ((v & 0x00ff00ff00ff00ff) << 8);
+	top->data = ram.read64(2*(top->vaddr&(VIKING?0x1fffc:0x7ffc)));
 
 	// Bus cycles 0 and 2 may be used by video
 	// Usually shifter uses 0 (incl STE DMA audio)
@@ -193,6 +272,7 @@ void eval(void) {
 	// And MISTXVID uses 0 and 2 (and thus doesn't support STE DMA audio)
 	if((top->bus_cycle != 0)&&(top->bus_cycle != 2)) {
 	  printf("illegal read in bus_cycle %d\n", top->bus_cycle);
+	  trace_fail();
 	  exit(-1);
 	}
       }
@@ -204,15 +284,8 @@ void eval(void) {
   if(dump_enabled) { 
     static int last_clk = 0;
     // scan doubled output is always analyzed at 32MHz
-    if(!
-#if VIKING
-       top->clk_128
-#elif SD
-       top->clk_32
-#else
-       top->v__DOT__shifter__DOT__pclk
-#endif
-       && last_clk) {
+    int clk = VIKING?top->clk_128:SD?top->clk_32:top->v__DOT__shifter__DOT__pclk;
+    if(!clk && last_clk) {
       static int last_hs=0, last_vs=0;
       static int x=0, y=0;
       
@@ -234,160 +307,124 @@ void eval(void) {
 	if(last_hs == top->v__DOT__osd__DOT__hs_pol)
 	  { x = 0; y++; }
 	last_hs = top->v__DOT__stvid_hs;
-
-	/* update the screen */
-	SDL_UpdateRect(screen, 0, 0, 0, 0);
       }
       if(top->v__DOT__stvid_vs != last_vs) {
-	if(top->v__DOT__stvid_vs) y = 0;
+	if(top->v__DOT__stvid_vs) { y = 0; frame_done(); }
 	last_vs = top->v__DOT__stvid_vs;
       }
     }
-#if VIKING
-    last_clk = top->clk_128;
-#elif SD
-    last_clk = top->clk_32;
-#else
-    last_clk = top->v__DOT__shifter__DOT__pclk;
-#endif
+    last_clk = clk;
   }
 }
 
-unsigned long cpu_write_addr = 0;
-unsigned short cpu_write_data;
-
-// advance time and create valid 8 Mhz clock and signals
-// derived from it 
-void wait_ns(double n) {
-  static double clk_time = 0;
-
-  eval();
-
-  // check if next clk event is within waiting period
-  while(clk_time <= n) {
-    time_ns += clk_time;    // advance time to next clk event
-    n -= clk_time;          // reduce remainung waiting time
-
-    // process change on clk 
-#if VIKING    
-    // viking needs 128MHz
-    top->clk_128 = !top->clk_128;
-    eval();
-    static int x = 0;
-    if(x++ == 3) {
-    x = 0;
-#else
-    {
-#endif
+st_bus_t<Vvideo> bus;
 
-    top->clk_32 = !top->clk_32;
-    eval();
+// things supposed to happen on the rising 32MHz clock edge. The 8MHz
+// cpu clock and the bus cycle are derived from it
+int clk32_edge(int level) {
+  static int clk_cnt = 0;
 
-    // things supposed to happen on rising clock edge
-    if(top->clk_32) {
-      // every 4th cycle ...
-      static int clk_cnt = 0;
+  if(!level) return 0;
 
-      if(clk_cnt == 1)
-	top->bus_cycle = (top->bus_cycle + 1) &3;
+  // every 4th cycle ...
+  if(clk_cnt == 1)
+    top->bus_cycle = (top->bus_cycle + 1) &3;
 
-      clk_cnt = clk_cnt + 1;
-      top->cpu_clk = (clk_cnt&2)?1:0;   // 8MHz
+  clk_cnt = clk_cnt + 1;
+  top->cpu_clk = (clk_cnt&2)?1:0;   // 8MHz
 
-      if(clk_cnt == 4) clk_cnt = 0;
+  if(clk_cnt == 4) clk_cnt = 0;
 
-      // ------------ cpu access ---------------
-      if(clk_cnt == 2) {
-	top->cpu_sel = 0;	  
-	
-	if(top->bus_cycle == 0) {
+  // ------------ cpu access ---------------
+  if(clk_cnt == 2) {
+#ifdef MUSASHI
+    cpu_clock();
+#endif
+    bus.posedge();
+  }
 
-	  // perform cpu write access
-	  if(cpu_write_addr) {
-	    printf("CPU WRITE $%lx = $%x\n", cpu_write_addr, cpu_write_data);
+  if(clk_cnt == 0)
+    bus.negedge();
 
-	    top->cpu_sel = (cpu_write_addr & ~0xff) == 0xff8200;
-	    top->cpu_addr = (cpu_write_addr & 0xff)>>1;
-	    top->cpu_rw = 0;
-	    top->cpu_din = cpu_write_data;
-	    top->cpu_uds = top->cpu_lds = 0;
-	    cpu_write_addr = 0;
-	  }
-	}
-      }
+  return 1;
+}
+
+void cpu_write_short(unsigned long addr, unsigned short data) {
+  printf("CPU WRITE $%lx = $%x\n", addr, data);
+  bus.write(addr, ((data & 0xff)<<8) | ((data & 0xff00)>>8));
+}
+ 
+// parse NAME=value arguments, +args are left to verilator
+void parse_options(int argc, char **argv) {
+  int i, j;
+
+  for(i=1;i<argc;i++) {
+    char *eq = strchr(argv[i], '=');
+    if(argv[i][0] == '+') continue;
+
+    for(j=0;eq && options[j].name;j++)
+      if(strlen(options[j].name) == (size_t)(eq-argv[i]) &&
+	 !strncmp(argv[i], options[j].name, eq-argv[i]))
+	break;
+
+    if(!eq || !options[j].name) {
+      printf("Usage: %s [NAME=value ...]\n  NAME is one of", argv[0]);
+      for(j=0;options[j].name;j++) printf(" %s", options[j].name);
+      printf("\n");
+      exit(-1);
     }
+    *options[j].val = atoi(eq+1);
   }
-    eval();
 
-#if VIKING    
-    clk_time = MHZ2NS(4*CLK)/2.0; // next clk change in 3.9ns
-#else
-    clk_time = MHZ2NS(CLK)/2.0; // next clk change in 31.25ns
-#endif
+  if(REZ < 0 || REZ > 2) {
+    printf("REZ must be 0, 1 or 2\n");
+    exit(-1);
   }
 
-  // next event is when done waiting
-  time_ns += n; // advance time
-  clk_time -= n;
-}
-
-void wait_us(double n) {
-  wait_ns(n * 1000.0);
-}
+  if(VIKING) {
+    W = 900;
+    H = 540;
+  } else {
+    W = (REZ==0 && !SD)?513:1026;
+    H = (REZ==2 || SD)?626:313;
+  }
 
-void wait_ms(double n) {
-  wait_us(n * 1000.0);
+  printf("Mode: %s\n", mode_name());
 }
 
-void cpu_write_short(unsigned long addr, unsigned short data) {
-  cpu_write_addr = addr;
-  cpu_write_data = ((data & 0xff)<<8) | ((data & 0xff00)>>8);
-  wait_us(1);               // wait two 2MHz system cycles
-}
- 
 int main(int argc, char **argv, char **env) {
+  parse_options(argc, argv);
+  fb = new Uint32[W*H];
+  memset(fb, 0, 4*W*H);
 
-#if STE_SHIFT != 0
-#if REZ == 0
-#define XTRA_OFFSET (8+2*STE_LINE_OFFSET)    // 16 pixels * 4 bit
-#elif REZ == 1
-#define XTRA_OFFSET (4+2*STE_LINE_OFFSET)    // 16 pixels * 2 bit
-#else
-#define XTRA_OFFSET (2+2*STE_LINE_OFFSET)    // 16 pixels * 1 bit
-#endif
-#else
-#define XTRA_OFFSET (0+2*STE_LINE_OFFSET)
-#endif
+  // 16 pixels * 4, 2 or 1 bit
+  int XTRA_OFFSET = (STE_SHIFT?(8>>REZ):0) + 2*STE_LINE_OFFSET;
 
-  memset(vidmem, 0x80, sizeof(vidmem));
+  ram.init(0, VIDMEM_SIZE);
+  vidmem = ram.mem;
+  memset(vidmem, 0x80, VIDMEM_SIZE);
 
   // load image
-#if VIKING
-  FILE *in = fopen("viking.raw", "rb");
-  if(in) {
-    fread(vidmem, 1280*1024/8, 1, in);
-    fclose(in); 
-  }
-
-#else
-#if REZ == 0
-  FILE *in = fopen("low.raw", "rb");
-#elif REZ == 1
-  FILE *in = fopen("mid.raw", "rb");
-#else
-  FILE *in = fopen("high.raw", "rb");
-#endif
-  if(in) {
-    // load single lines with offset if wanted
-    int i;
-    unsigned char *p = vidmem;
-    for(i=0;i<200;i++) {
-      fread(p, 160, 1, in);
-      p += 160+XTRA_OFFSET;
+  if(VIKING) {
+    FILE *in = fopen("viking.raw", "rb");
+    if(in) {
+      fread(vidmem, 1280*1024/8, 1, in);
+      fclose(in); 
+    }
+  } else {
+    const char *raw[] = { "low.raw", "mid.raw", "high.raw" };
+    FILE *in = fopen(raw[REZ], "rb");
+    if(in) {
+      // load single lines with offset if wanted
+      int i;
+      unsigned char *p = vidmem;
+      for(i=0;i<200;i++) {
+	fread(p, 160, 1, in);
+	p += 160+XTRA_OFFSET;
+      }
+      fclose(in); 
     }
-    fclose(in); 
   }
-#endif
 
 #if 0
   // add some test pattern to the begin
@@ -411,6 +448,7 @@ int main(int argc, char **argv, char **env) {
   }}
 #endif
   
+#ifndef HEADLESS
   /* initialize SDL */
   SDL_Init(SDL_INIT_VIDEO);
   
@@ -418,43 +456,38 @@ int main(int argc, char **argv, char **env) {
   SDL_WM_SetCaption("SDL Test", "SDL Test");
   
   /* create window */
-  screen = SDL_SetVideoMode(W, H, 0, 0);
+  screen = SDL_SetVideoMode(W, H, 32, 0);
+#endif
 
   Verilated::commandArgs(argc, argv);
   // init top verilog instance
   top = new Vvideo;
+  sim_init(top);
 
-#if DUMP
-  // init trace dump
-  Verilated::traceEverOn(true);
-  tfp = new VerilatedVcdC;
-  top->trace (tfp, 99);
-  tfp->open ("video.vcd");
-#endif
+  // init trace dump, see trace.h
+  trace_init(top, "video");
+  sim_trace = 0;
+  sim_eval_hook = video_eval;
 
   // initialize system inputs
   top->clk_32 = 1;
+  bus.init(top, 0xff8200, ~0xff);
+  // viking needs 128MHz
+  if(VIKING) sim_add_clock(&top->clk_128, 4*CLK);
+  sim_add_clock(&top->clk_32, CLK, NULL, clk32_edge);
 
-#if REZ == 0
   // setup palette
-  unsigned char x,coltab[][3] = {
-    { 7,7,7 }, { 7,0,0 }, { 0,7,0 }, { 7,7,0 }, { 0,0,7 }, { 7,0,7 }, { 0,7,7 }, { 5,5,5 },
-    { 3,3,3 }, { 7,3,3 }, { 3,7,3 }, { 7,7,3 }, { 3,3,7 }, { 7,3,7 }, { 3,7,7 }, { 0,0,0 }};
-  for(x=0;x<16;x++) {
-    top->v__DOT__shifter__DOT__palette_r[x] = coltab[x][0];  
-    top->v__DOT__shifter__DOT__palette_g[x] = coltab[x][1];  
-    top->v__DOT__shifter__DOT__palette_b[x] = coltab[x][2];  
-  }
-#elif REZ == 1
-  // setup palette
-  unsigned char x,coltab[][3] = {
-  { 7,7,7 }, { 7,0,0 }, { 0,7,0 }, { 0,0,0 } };
-  for(x=0;x<4;x++) {
-    top->v__DOT__shifter__DOT__palette_r[x] = coltab[x][0];  
-    top->v__DOT__shifter__DOT__palette_g[x] = coltab[x][1];  
-    top->v__DOT__shifter__DOT__palette_b[x] = coltab[x][2];  
+  if(REZ < 2) {
+    unsigned char x,coltab[2][16][3] = {{
+      { 7,7,7 }, { 7,0,0 }, { 0,7,0 }, { 7,7,0 }, { 0,0,7 }, { 7,0,7 }, { 0,7,7 }, { 5,5,5 },
+      { 3,3,3 }, { 7,3,3 }, { 3,7,3 }, { 7,7,3 }, { 3,3,7 }, { 7,3,7 }, { 3,7,7 }, { 0,0,0 }}, {
+      { 7,7,7 }, { 7,0,0 }, { 0,7,0 }, { 0,0,0 } }};
+    for(x=0;x<(REZ?4:16);x++) {
+      top->v__DOT__shifter__DOT__palette_r[x] = coltab[REZ][x][0];  
+      top->v__DOT__shifter__DOT__palette_g[x] = coltab[REZ][x][1];  
+      top->v__DOT__shifter__DOT__palette_b[x] = coltab[REZ][x][2];  
+    }
   }
-#endif
 
 #if 1
   // show OSD
@@ -494,46 +527,35 @@ int main(int argc, char **argv, char **env) {
   top->scanlines = SL;
 
   // reset
-  wait_ns(100);
+  sim_wait_ns(100);
   top->cpu_reset = 1;
-  wait_ns(random()%2000);
+  sim_wait_ns(random()%2000);
   top->cpu_reset = 0;
 
   top->v__DOT__shifter__DOT__hcnt = random();
  
-#if (STE_SHIFT != 0) || (STE_LINE_OFFSET != 0)
-  top->ste = 1;
-  top->v__DOT__shifter__DOT__pixel_offset = STE_SHIFT;
-  top->v__DOT__shifter__DOT__line_offset = STE_LINE_OFFSET;
-#endif
-
-#if VIKING
-  wait_ms(13+14.5);
-#else
-
-#if REZ != 2
-  // switch to pal 50 hz lowrez
-  top->pal56 = PAL56;    
-  top->v__DOT__shifter__DOT__shmode = REZ;    // lowrez/mid
-  top->v__DOT__shifter__DOT__syncmode = PAL?2:0;  // pal
+  if(STE_SHIFT || STE_LINE_OFFSET) {
+    top->ste = 1;
+    top->v__DOT__shifter__DOT__pixel_offset = STE_SHIFT;
+    top->v__DOT__shifter__DOT__line_offset = STE_LINE_OFFSET;
+  }
 
-#if PAL
-#if PAL56 && SD
-#define IMGTIME (612 * 928 * 1000 / CLK)
-  wait_ms(34+2*IMGTIME); // PAL56
-#else
-#define IMGTIME (626 * 1024 * 1000 / CLK) // one full image has 626 lines @ 32us   = 40.064
-  wait_ms(36+2*IMGTIME); // PAL50
-#endif 
-#else
-#define IMGTIME (526 * 1016 * 1000 / CLK)
-  wait_ms(31+2*IMGTIME); // NTSC
-#endif
-#else
-  // skip forward to first image
-  wait_ms(12);
-#endif
-#endif
+  if(VIKING)
+    sim_wait_ms(13+14.5);
+  else if(REZ != 2) {
+    // switch to pal 50 hz lowrez
+    top->pal56 = PAL56;    
+    top->v__DOT__shifter__DOT__shmode = REZ;    // lowrez/mid
+    top->v__DOT__shifter__DOT__syncmode = PAL?2:0;  // pal
+
+    // one full PAL50 image has 626 lines @ 32us = 40.064
+    if(PAL && PAL56 && SD) sim_wait_ms(34+2*(612 * 928 * 1000 / CLK));   // PAL56
+    else if(PAL)           sim_wait_ms(36+2*(626 * 1024 * 1000 / CLK));  // PAL50
+    else                   sim_wait_ms(31+2*(526 * 1016 * 1000 / CLK));  // NTSC
+  } else {
+    // skip forward to first image
+    sim_wait_ms(12);
+  }
 
   // fetch image parameters
   //   top->v__DOT__shifter__DOT__de_h_end
@@ -549,23 +571,30 @@ int main(int argc, char **argv, char **env) {
   // t10_v_border_top
   // t11_v_end
 
-#if !VIKING
-#if REZ==0
-#define PCLK CLK/4
-#elif REZ==1
-#define PCLK CLK/2
-#else
-#define PCLK CLK
-#endif
-  printf("Timing:\n");
-  printf("Total: %d\n", top->v__DOT__shifter__DOT__t5_h_end+1);
-  printf("HFreq: %.3fkHz\n", PCLK/1000/(top->v__DOT__shifter__DOT__t5_h_end+1));
+  if(!VIKING) {
+    double PCLK = CLK/(4>>REZ);
+    printf("Timing:\n");
+    printf("Total: %d\n", top->v__DOT__shifter__DOT__t5_h_end+1);
+    printf("HFreq: %.3fkHz\n", PCLK/1000/(top->v__DOT__shifter__DOT__t5_h_end+1));
 
-  // v__DOT__shifter__DOT__config_string[2U]
-#endif
+    // v__DOT__shifter__DOT__config_string[2U]
+  }
 
   printf("DUMP ENABLE\n");
   dump_enabled = 1;
+  sim_trace = 1;
+
+#ifdef MUSASHI
+  // CPU=video_cpu.bin runs 68000 code against the video registers
+  ram_t cpu_ram;
+  if(getenv("CPU")) {
+    // code and stack above the video memory
+    cpu_ram.init(0x100000, 64*1024);
+    if(cpu_init(&bus, &cpu_ram, getenv("CPU"))) exit(1);
+    cpu_map(&ram);
+    cpu_start();
+  }
+#endif
 
   // verify scan doubler state
   //  printf("Scandoubler:\n");
@@ -574,33 +603,32 @@ int main(int argc, char **argv, char **env) {
 
   //  printf("scan doubler is %s\n", top->v__DOT__scandoubler_enabled?"enabled":"disabled");
 
-#if VIKING
-  wait_ms(14);
-#else
-#if REZ != 2
-#if PAL
-#if PAL56 && SD  // PAL56
-  wait_ms(18);
-#else
-  wait_ms(21); // PAL50
-#endif
-#else
-  wait_ms(18);  // NTSC
-#endif
-#else
-  wait_ms(16);
-#endif
+  if(VIKING)              sim_wait_ms(14);
+  else if(REZ == 2)       sim_wait_ms(16);
+  else if(PAL && PAL56 && SD) sim_wait_ms(18);  // PAL56
+  else if(PAL)            sim_wait_ms(21);  // PAL50
+  else                    sim_wait_ms(18);  // NTSC
+
+#ifdef MUSASHI
+  if(getenv("CPU")) {
+    while(!cpu_stopped && sim_time < SIM_US(200000))
+      sim_wait_ms(1);
+    cpu_report();
+    printf("cpu: %d counter polls\n", m68k_get_reg(NULL, M68K_REG_D7));
+  }
 #endif
 
-#if DUMP
-  tfp->close();
-#endif
+  if(frame_errors) trace_fail();
+  else             trace_close();
+  sim_report();
 
+#ifndef HEADLESS
   getchar();
 
   /* cleanup SDL */
   SDL_Quit();
+#endif
 
-  exit(0);
+  exit(frame_errors?1:0);
  }
 